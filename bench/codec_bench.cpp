@@ -0,0 +1,58 @@
+#include <value_codec.h>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Measure encoding and decoding of all values with given functions, in nanoseconds per value.
+ */
+template <typename T, typename Encode, typename Decode>
+static void measure(const std::string& name, const std::vector<T>& values, Encode encode, Decode decode)
+{
+    std::vector<std::string> encoded;
+    encoded.reserve(values.size());
+    auto encode_start = std::chrono::steady_clock::now();
+    for (const T& value : values)
+        encoded.push_back(encode(value));
+    std::chrono::duration<double, std::nano> encode_time = std::chrono::steady_clock::now() - encode_start;
+
+    // Decoded values are summed, so the compiler cannot drop the decoding.
+    double checksum = 0;
+    std::size_t bytes = 0;
+    auto decode_start = std::chrono::steady_clock::now();
+    for (const std::string& value : encoded)
+    {
+        checksum += decode(value);
+        bytes += value.size();
+    }
+    std::chrono::duration<double, std::nano> decode_time = std::chrono::steady_clock::now() - decode_start;
+
+    std::cout << name << ": encode " << encode_time.count() / values.size() << " ns, decode "
+              << decode_time.count() / values.size() << " ns, " << static_cast<double>(bytes) / values.size()
+              << " bytes per value (checksum " << checksum << ")" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    std::size_t count = argc > 1 ? std::stoul(argv[1]) : 1000000;
+
+    std::vector<float> floats;
+    std::vector<int> ints;
+    floats.reserve(count);
+    ints.reserve(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        ints.push_back(static_cast<int>(static_cast<long long>(i) * 7919 % 1000000) - 500000);
+        ints.push_back(static_cast<int>(i * 7919) - 500000);
+    }
+
+    measure<float>("float to_string/stof  ", floats, [](float value){ return std::to_string(value); }, [](const std::string& encoded){ return std::stof(encoded); });
+    measure<float>("float DefaultCodec    ", floats, DefaultCodec<float>::encode, DefaultCodec<float>::decode);
+    measure<float>("float BinaryCodec     ", floats, BinaryCodec<float>::encode, BinaryCodec<float>::decode);
+    measure<int>("int to_string/stoi    ", ints, [](int value){ return std::to_string(value); }, [](const std::string& encoded){ return std::stoi(encoded); });
+    measure<int>("int DefaultCodec      ", ints, DefaultCodec<int>::encode, DefaultCodec<int>::decode);
+    measure<int>("int BinaryCodec       ", ints, BinaryCodec<int>::encode, BinaryCodec<int>::decode);
+    return 0;
+}
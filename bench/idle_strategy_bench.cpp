@@ -0,0 +1,78 @@
+#include <redis_handler.h>
+#include <topic_manager.h>
+#include <cache_value.h>
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+static double processCpuSeconds()
+{
+    timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char** argv)
+{
+    std::string strategy = argc > 1 ? argv[1] : "blocking";
+    int samples = argc > 2 ? std::stoi(argv[2]) : 1000;
+
+    RedisConfig config;
+    if (strategy == "busy-spin")
+        config.idle_strategy = IdleStrategy::BusySpin;
+    else if (strategy == "backoff")
+        config.idle_strategy = IdleStrategy::Backoff;
+    else if (strategy == "blocking")
+        config.idle_strategy = IdleStrategy::Blocking;
+    else
+    {
+        std::cerr << "Usage: " << argv[0] << " <busy-spin|backoff|blocking> [samples]" << std::endl;
+        return 1;
+    }
+    RedisHandler::configure(config);
+
+    TopicManager::getInstance().createTopic("idle_strategy_bench");
+    CacheInt value("latency", "idle_strategy_bench", 0);
+
+    // Writes come from a separate connection, like from another process.
+    sw::redis::ConnectionOptions writer_options;
+    writer_options.host = config.host;
+    writer_options.port = config.port;
+    writer_options.db = config.db;
+    sw::redis::Redis writer(writer_options);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    value.toInt();
+
+    auto idle_start = std::chrono::steady_clock::now();
+    double cpu_start = processCpuSeconds();
+    std::this_thread::sleep_for(std::chrono::seconds(2));
+    std::chrono::duration<double> idle_wall = std::chrono::steady_clock::now() - idle_start;
+    double idle_cpu = (processCpuSeconds() - cpu_start) / idle_wall.count();
+
+    std::vector<double> latencies;
+    latencies.reserve(samples);
+    for (int i = 1; i <= samples; ++i)
+    {
+        auto start = std::chrono::steady_clock::now();
+        writer.set("idle_strategy_bench:latency", std::to_string(i));
+        while (!value.isChanged())
+            ;
+        std::chrono::duration<double, std::micro> latency = std::chrono::steady_clock::now() - start;
+        latencies.push_back(latency.count());
+        value.toInt();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    std::cout << "strategy:                     " << strategy << std::endl;
+    std::cout << "idle CPU:                     " << idle_cpu * 100 << " % of one core" << std::endl;
+    std::cout << "notification latency p50:     " << latencies[latencies.size() / 2] << " us" << std::endl;
+    std::cout << "notification latency p99:     " << latencies[latencies.size() * 99 / 100] << " us" << std::endl;
+    std::cout << "notification latency max:     " << latencies.back() << " us" << std::endl;
+    return 0;
+}
@@ -0,0 +1,84 @@
+#include <keyspace_channel.h>
+#include <topic_manager.h>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Parsing as it was done in the on_pmessage callback, kept here only for comparison.
+static void istringstreamPath(std::string channel)
+{
+    std::istringstream msgstream(channel);
+    std::getline(msgstream, channel, ':');
+    std::string topic_path;
+    std::string value_id;
+
+    std::getline(msgstream, topic_path, ':');
+    std::getline(msgstream, value_id, ':');
+    TopicManager::getInstance().addChangedParameter(topic_path, value_id);
+}
+
+static void stringViewPath(std::string_view channel, std::vector<KeyspaceChannel>& changes)
+{
+    KeyspaceChannel parsed;
+    if (!KeyspaceChannel::parse(channel, parsed))
+        return;
+    changes.assign(1, parsed);
+    TopicManager::getInstance().addChangedParameters(parsed.topic_path, changes);
+}
+
+template <typename Fn>
+static double eventsPerSecond(std::size_t events, Fn&& fn)
+{
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return events / elapsed.count();
+}
+
+int main(int argc, char** argv)
+{
+    std::string corpus_path = argc > 1 ? argv[1] : "bench/keyspace_channels.txt";
+    int iterations = argc > 2 ? std::stoi(argv[2]) : 1000;
+
+    // Corpus is recorded with `redis-cli psubscribe '__keyspace@0__:*'`, one `<channel> <event>` pair per line.
+    std::ifstream corpus(corpus_path);
+    if (!corpus)
+    {
+        std::cerr << "Cannot open corpus " << corpus_path << std::endl;
+        return 1;
+    }
+    std::vector<std::string> channels;
+    std::string line;
+    while (std::getline(corpus, line))
+    {
+        if (!line.empty())
+            channels.push_back(line.substr(0, line.find(' ')));
+    }
+
+    for (const char* topic : {"sensors", "config", "sessions", "orders", "metrics", "dashboard"})
+        TopicManager::getInstance().createTopic(topic);
+
+    std::size_t events = channels.size() * iterations;
+    double old_rate = eventsPerSecond(events, [&]()
+                                      {
+        for (int i = 0; i < iterations; ++i)
+            for (const std::string& channel : channels)
+                istringstreamPath(channel); });
+
+    std::vector<KeyspaceChannel> changes;
+    changes.reserve(1);
+    double new_rate = eventsPerSecond(events, [&]()
+                                      {
+        for (int i = 0; i < iterations; ++i)
+            for (const std::string& channel : channels)
+                stringViewPath(channel, changes); });
+
+    std::cout << "channels in corpus: " << channels.size() << ", iterations: " << iterations << std::endl;
+    std::cout << "istringstream path: " << static_cast<long long>(old_rate) << " events/s" << std::endl;
+    std::cout << "string_view path:   " << static_cast<long long>(new_rate) << " events/s" << std::endl;
+    std::cout << "speedup:            " << new_rate / old_rate << "x" << std::endl;
+    return 0;
+}
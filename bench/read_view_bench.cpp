@@ -0,0 +1,40 @@
+#include <redis_handler.h>
+#include <topic_manager.h>
+#include <cache_value.h>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <map>
+#include <string>
+
+int main(int argc, char** argv)
+{
+    int fields = argc > 1 ? std::stoi(argv[1]) : 10000;
+    int reads = argc > 2 ? std::stoi(argv[2]) : 1000;
+
+    std::map<std::string, std::string> value;
+    for (int i = 0; i < fields; ++i)
+        value.emplace("field_" + std::to_string(i), "value_of_field_" + std::to_string(i));
+
+    TopicManager::getInstance().createTopic("read_view_bench");
+    CacheMap cache_map("map", "read_view_bench", value);
+    cache_map.view();
+
+    // Sizes are summed, so the compiler cannot drop the reads.
+    std::size_t checksum = 0;
+    auto copy_start = std::chrono::steady_clock::now();
+    for (int i = 0; i < reads; ++i)
+        checksum += cache_map.toMap().size();
+    std::chrono::duration<double, std::micro> copy_time = std::chrono::steady_clock::now() - copy_start;
+
+    auto view_start = std::chrono::steady_clock::now();
+    for (int i = 0; i < reads; ++i)
+        checksum += cache_map.view().size();
+    std::chrono::duration<double, std::micro> view_time = std::chrono::steady_clock::now() - view_start;
+
+    std::cout << "fields:                       " << fields << std::endl;
+    std::cout << "toMap() per read:             " << copy_time.count() / reads << " us" << std::endl;
+    std::cout << "view() per read:              " << view_time.count() / reads << " us" << std::endl;
+    std::cout << "checksum:                     " << checksum << std::endl;
+    return 0;
+}
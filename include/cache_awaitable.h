@@ -0,0 +1,101 @@
+#ifndef CACHE_AWAITABLE_H
+#define CACHE_AWAITABLE_H
+
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <utility>
+
+#include <redis_handler.h>
+
+/**
+ * @brief Callback completing an asynchronous operation, with the exception of the operation if it failed.
+ */
+using AsyncDone = std::function<void(std::exception_ptr)>;
+
+/**
+ * @brief Awaitable cache operation for C++20 coroutines.
+ * 
+ * Operation is started when the coroutine is suspended and the coroutine is resumed through
+ * `RedisHandler::resume` when Redis replies, so no thread is blocked while waiting. Result is
+ * computed on the resumed coroutine, which makes it the thread reading the value.
+ * 
+ * @tparam T Type of the result of `co_await`.
+ */
+template <typename T>
+class CacheAwaitable {
+public:
+    /**
+     * @brief Function starting the operation and calling given callback when it is done.
+     */
+    using Start = std::function<void(AsyncDone)>;
+
+    /**
+     * @brief Function computing the result of the operation after the coroutine is resumed.
+     */
+    using Result = std::function<T()>;
+
+    /**
+     * @brief Construct a new `CacheAwaitable` object.
+     * 
+     * @param ready Whether the result is available without starting the operation.
+     * @param start Function starting the operation.
+     * @param result Function computing the result of the operation.
+     */
+    CacheAwaitable(bool ready, Start start, Result result) : ready_(ready), start_(std::move(start)), result_(std::move(result)) {}
+
+    /**
+     * @brief Check if the coroutine can continue without suspending.
+     */
+    bool await_ready() const noexcept {
+        return ready_;
+    }
+
+    /**
+     * @brief Start the operation, coroutine is resumed when it is done.
+     * 
+     * @param handle Handle of the suspended coroutine.
+     */
+    void await_suspend(std::coroutine_handle<> handle){
+        // Coroutine may be resumed and the awaitable destroyed before the operation returns, so it runs from a local.
+        Start start = std::move(start_);
+        start([this, handle](std::exception_ptr error){
+            error_ = error;
+            RedisHandler::getInstance().resume(handle);
+        });
+    }
+
+    /**
+     * @brief Get the result of the operation, rethrowing its exception if it failed.
+     * 
+     * @return The result of the operation.
+     */
+    T await_resume(){
+        if (error_)
+            std::rethrow_exception(error_);
+        return result_();
+    }
+
+private:
+    /**
+     * @brief Whether the result is available without starting the operation.
+     */
+    bool ready_;
+
+    /**
+     * @brief Function starting the operation.
+     */
+    Start start_;
+
+    /**
+     * @brief Function computing the result of the operation.
+     */
+    Result result_;
+
+    /**
+     * @brief Exception of the failed operation.
+     */
+    std::exception_ptr error_;
+};
+
+#endif // CACHE_AWAITABLE_H
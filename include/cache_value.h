@@ -2,12 +2,89 @@
 #define CACHE_VALUE_H
 
 #include <string>
+#include <algorithm>
 #include <any>
+#include <atomic>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <type_traits>
 
 #include <redis_handler.h>
+#include <cache_awaitable.h>
+#include <value_codec.h>
+#include <compression.h>
 
 class Topic;
 
+/**
+ * @brief Callback receiving the reply of an asynchronous fetch, as a function replacing local copy of the value with it.
+ * 
+ * The function throws if the fetch failed and has to be called by the thread reading the value.
+ */
+using FetchDone = std::function<void(std::function<void()>)>;
+
+/**
+ * @brief Tag selecting constructors which bind a cache value to an existing key without writing it to Redis.
+ */
+struct AttachTag{
+    explicit AttachTag() = default;
+};
+
+/**
+ * @brief Change of a key described by the events of its keyspace notifications since the last fetch.
+ */
+enum class KeyEvent : std::uint8_t {
+    /**
+     * @brief No event was recorded, the value has to be fetched whole.
+     */
+    None,
+
+    /**
+     * @brief The key changed in a way the value cannot apply cheaply, it has to be fetched whole.
+     */
+    Changed,
+
+    /**
+     * @brief The key was deleted, expired or evicted. Local copy is cleared without fetching.
+     */
+    Deleted,
+
+    /**
+     * @brief Elements were only pushed to the tail of the list, or bytes were only appended to the string.
+     */
+    Appended,
+
+    /**
+     * @brief Elements were only pushed to the head of the list.
+     */
+    Prepended,
+
+    /**
+     * @brief Elements were only popped from the tail of the list.
+     */
+    PoppedTail,
+
+    /**
+     * @brief Elements were only popped from the head of the list.
+     */
+    PoppedHead,
+
+    /**
+     * @brief New encoded value was published by its writer. Local copy is replaced by it without fetching.
+     */
+    Published
+};
+
 /**
  * @brief Abstract base class for cache values.
  * 
@@ -27,16 +104,362 @@ protected:
      */
     Topic* topic_;
 
+    /**
+     * @brief Version of the value in Redis.
+     * 
+     * Bumped by the `RedisHandler` subscriber thread every time a change notification for this value arrives.
+     */
+    std::atomic<std::uint64_t> version_;
+
+    /**
+     * @brief Version of the value at the moment of the last fetch from Redis.
+     * 
+     * Owned by the thread reading the value, so it does not need to be atomic.
+     */
+    std::uint64_t fetched_version_;
+
+    /**
+     * @brief Epoch of the value at the moment of the last fetch from Redis, see `epoch_`.
+     * 
+     * Owned by the thread reading the value. Value whose epoch has changed is fetched whole, ignoring recorded changes.
+     */
+    std::uint64_t fetched_epoch_;
+
+    /**
+     * @brief Get the current invalidation epoch of the value, which is the epoch of its topic.
+     * 
+     * @return The epoch.
+     */
+    std::uint64_t epoch_() const;
+
+    /**
+     * @brief Number of notifications expected as an echo of writes made by this value.
+     * 
+     * Incremented before a write whose notification count does not depend on the state of the key, decremented by
+     * the subscriber thread when the echo arrives. An external write interleaving with own writes may consume the
+     * count instead, but then own echo arrives later and marks the value as changed, so nothing is missed.
+     */
+    std::atomic<std::uint32_t> pending_echoes_;
+
+    /**
+     * @brief Keyspace event class required by the value while it is registered in a topic.
+     * 
+     * Cached by the `Topic` on registration, so it can be released from the destructor.
+     */
+    char keyspace_event_class_;
+
+    /**
+     * @brief Events of notifications received since the last fetch, combined into a single change.
+     */
+    KeyEvent pending_event_;
+
+    /**
+     * @brief Encoded value carried by the last published message, valid while `pending_event_` is `KeyEvent::Published`.
+     */
+    std::string published_value_;
+
+    /**
+     * @brief Whether a notification was consumed as own echo since the last fetch, so the recorded change may be own one
+     * while the foreign one was dropped.
+     */
+    bool echo_consumed_;
+
+    /**
+     * @brief Mutex guarding `pending_event_`, `published_value_` and `echo_consumed_`, which is written by the subscriber thread and taken by the reading thread.
+     */
+    std::mutex event_mutex_;
+
+    /**
+     * @brief Get the change described by an event of keyspace notification.
+     * 
+     * @param event The event, e.g. `rpush` or `del`. Empty if the notification does not carry it.
+     * @return The change.
+     */
+    static KeyEvent parseEvent_(std::string_view event);
+
+    /**
+     * @brief Combine a recorded change with a change which happened after it.
+     * 
+     * Deletion and published value replace anything before them, changes of the same kind stay cheap, anything else needs a full fetch.
+     * 
+     * @param pending The recorded change.
+     * @param next The change which happened after it.
+     * @return The combined change.
+     */
+    static KeyEvent combineEvents_(KeyEvent pending, KeyEvent next);
+
+    /**
+     * @brief Take the recorded change and reset it. Called by the reading thread before fetching the value.
+     * 
+     * @return The recorded change.
+     */
+    KeyEvent takeEvent_();
+
+    /**
+     * @brief Take the recorded change together with the published value and reset it.
+     * 
+     * Change which can be applied as a delta is returned as `KeyEvent::Changed` if an echo was consumed in the same window.
+     * 
+     * @param published_value Set to the published value if the change is `KeyEvent::Published`.
+     * @return The recorded change.
+     */
+    KeyEvent takeEvent_(std::string& published_value);
+
     /**
      * @brief Remove the value from Redis.
      */
-    void removeValueFromRedis_();
+    virtual void removeValueFromRedis_();
+
+    /**
+     * @brief Get the key of the value in Redis.
+     * 
+     * @return The key, made of the topic path and the ID.
+     */
+    std::string redisKey_() const;
 
     /**
      * @brief Abstract method to add the value to Redis, to be implemented by derived classes.
      */
     virtual void addValueToRedis_() = 0;
 
+    /**
+     * @brief Abstract method to fetch the value from Redis into local copy, to be implemented by derived classes.
+     */
+    virtual void fetchValue_() = 0;
+
+    /**
+     * @brief Apply a change to local copy by fetching only the changed part of the value.
+     * 
+     * Default implementation applies nothing, so the value is fetched whole.
+     * 
+     * @param event The change recorded since the last fetch.
+     * @return `true` if the change was applied, `false` if the value has to be fetched whole.
+     */
+    virtual bool fetchDelta_(KeyEvent event);
+
+    /**
+     * @brief Replace local copy with a value published by its writer.
+     * 
+     * Only scalar values are published, default implementation fetches the value whole.
+     * 
+     * @param encoded The published encoded value.
+     */
+    virtual void applyPublished_(const std::string& encoded);
+
+    /**
+     * @brief Abstract method to reset local copy to the value of a missing key, to be implemented by derived classes.
+     */
+    virtual void clearValue_() = 0;
+
+    /**
+     * @brief Abstract method to start fetching the value from Redis asynchronously, to be implemented by derived
+     * classes.
+     * 
+     * @param done Callback called on the event loop thread of redis-plus-plus when the reply arrives.
+     */
+    virtual void fetchValueAsync_(FetchDone done) = 0;
+
+    /**
+     * @brief Abstract method returning keyspace event class of commands modifying the value, to be implemented
+     * by derived classes.
+     * 
+     * @return The keyspace event class, e.g. `$` for strings or `l` for lists.
+     */
+    virtual char keyspaceEventClass_() const = 0;
+
+    /**
+     * @brief Expect an echo notification of a write made by this value.
+     * 
+     * Does nothing in `InvalidationMode::Tracking`, where invalidations of one key can be coalesced.
+     */
+    void expectEcho_();
+
+    /**
+     * @brief Get the number of echoes of a single write which produces several keyspace notifications.
+     * 
+     * @param notifications Number of keyspace notifications of the write.
+     * @return The number of notifications, or 1 in `InvalidationMode::ChangeLog`, which logs each write once.
+     */
+    static std::uint32_t echoesOf_(std::uint32_t notifications);
+
+    /**
+     * @brief Cancel expected echo, e.g. when the write failed.
+     */
+    void cancelEcho_();
+
+    /**
+     * @brief Consume an expected echo notification.
+     * 
+     * @return `true` if the notification was expected as an echo, `false` otherwise.
+     */
+    bool consumeEcho_();
+
+    /**
+     * @brief Append the change of the value to the change log, if `InvalidationMode::ChangeLog` is used.
+     * 
+     * Called after every write of the value, readers of the change log then fetch the value again.
+     */
+    void logChange_();
+
+    /**
+     * @brief Queue appending the change of the value to the change log into a pipeline, if it is used.
+     * 
+     * @param pipeline The pipeline with the write of the value.
+     */
+    void logChange_(sw::redis::Pipeline& pipeline);
+
+    /**
+     * @brief Queue appending the change of the value to the change log into a transaction, if it is used.
+     * 
+     * @param transaction The transaction with the write of the value.
+     */
+    void logChange_(sw::redis::Transaction& transaction);
+
+    /**
+     * @brief Start appending the change of the value to the change log asynchronously, if it is used.
+     */
+    void logChangeAsync_();
+
+    /**
+     * @brief Run a write producing exactly one keyspace notification, and suppress the echo of it.
+     * 
+     * Writes whose notification count depends on the state of the key (e.g. `DEL`, `SADD`, `HDEL`) must not use it,
+     * they are simply refetched when their notification arrives.
+     * 
+     * @param write Callable writing the value through the `sw::redis::Redis` it is given.
+     * @param echoes Number of expected echoes, more than one if the write also publishes the value.
+     */
+    template <typename Write>
+    void writeWithEcho_(Write&& write, std::uint32_t echoes = 1){
+        for (std::uint32_t i = 0; i < echoes; ++i)
+            expectEcho_();
+        try {
+            write(*RedisHandler::getInstance().getRedis());
+        }
+        catch (...) {
+            for (std::uint32_t i = 0; i < echoes; ++i)
+                cancelEcho_();
+            throw;
+        }
+        logChange_();
+    }
+
+    /**
+     * @brief Run writes in a pipeline or transaction, and suppress echoes of given number of them.
+     * 
+     * Only writes producing exactly one keyspace notification may be counted, same as in `writeWithEcho_`.
+     * 
+     * @param queued The pipeline or transaction, executed after the writes are queued.
+     * @param echoes Number of expected echo notifications.
+     * @param write Callable queuing the writes into the pipeline or transaction it is given.
+     */
+    template <typename Queued, typename Write>
+    void writeQueued_(Queued queued, std::uint32_t echoes, Write&& write){
+        for (std::uint32_t i = 0; i < echoes; ++i)
+            expectEcho_();
+        try {
+            write(queued);
+            logChange_(queued);
+            queued.exec();
+        }
+        catch (...) {
+            for (std::uint32_t i = 0; i < echoes; ++i)
+                cancelEcho_();
+            throw;
+        }
+    }
+
+    /**
+     * @brief Start a write on the asynchronous connection of the `RedisHandler`.
+     * 
+     * Local copy is expected to be updated before the write. If the write fails, the value is marked as changed,
+     * so the local copy is fetched again on next read.
+     * 
+     * @param write Callable starting the write on the `sw::redis::AsyncRedis` it is given, with the callback it is given.
+     * @param echoes Number of expected echoes, 0 unless the write produces exactly one keyspace notification.
+     * @param done Callback called on the event loop thread of redis-plus-plus when Redis replies.
+     */
+    template <typename Write>
+    void writeAsync_(Write&& write, std::uint32_t echoes, AsyncDone done){
+        auto on_reply = [this, done, echoes](auto&& reply){
+            try {
+                reply.get();
+            }
+            catch (...) {
+                for (std::uint32_t i = 0; i < echoes; ++i)
+                    cancelEcho_();
+                version_.fetch_add(1, std::memory_order_release);
+                done(std::current_exception());
+                return;
+            }
+            logChangeAsync_();
+            done(nullptr);
+        };
+
+        for (std::uint32_t i = 0; i < echoes; ++i)
+            expectEcho_();
+        try {
+            write(*RedisHandler::getInstance().getAsyncRedis(), std::move(on_reply));
+        }
+        catch (...) {
+            for (std::uint32_t i = 0; i < echoes; ++i)
+                cancelEcho_();
+            version_.fetch_add(1, std::memory_order_release);
+            throw;
+        }
+    }
+
+    /**
+     * @brief Start an asynchronous operation and get a future of its completion.
+     * 
+     * @param start Callable starting the operation with the `AsyncDone` callback it is given.
+     * @return Future which is ready when the operation is done.
+     */
+    template <typename Start>
+    static std::future<void> futureOf_(Start&& start){
+        auto done = std::make_shared<std::promise<void>>();
+        std::future<void> result = done->get_future();
+        start([done](std::exception_ptr error){
+            if (error)
+                done->set_exception(error);
+            else
+                done->set_value();
+        });
+        return result;
+    }
+
+    /**
+     * @brief Fetch the value from Redis if it has changed since the last fetch.
+     * 
+     * Clean read costs a few atomic loads of the version and epochs. Version is loaded before fetching, so a change
+     * notification arriving during the fetch is not lost and triggers another fetch on next read.
+     */
+    void syncValue_();
+
+    /**
+     * @brief Mark the local copy as out of date, so it is fetched on the next read.
+     */
+    void markStale_();
+
+    /**
+     * @brief Mark the local copy as out of date in a way no delta can repair, so it is fetched whole on the next read.
+     */
+    void forceFetch_();
+
+    /**
+     * @brief Give the `Topic` class friend access.
+     * 
+     * This allows the `Topic` to detach values from itself when it is destroyed.
+     */
+    friend class Topic;
+
+    /**
+     * @brief Give the `WriteBatch` class friend access.
+     * 
+     * This allows the batch to suppress echoes of its writes.
+     */
+    friend class WriteBatch;
+
 public:
     /**
      * @brief Construct a new Abstract Cache Value object.
@@ -48,8 +471,10 @@ public:
 
     /**
      * @brief Destroy the Abstract Cache Value object.
+     * 
+     * Detaches the value from its topic, so the subscriber thread never touches destroyed value.
      */
-    virtual ~AbstractCacheValue() = default;
+    virtual ~AbstractCacheValue();
 
     /**
      * @brief Get the ID of the cache value.
@@ -72,6 +497,38 @@ public:
      */
     void changeTopic(std::string topic);
 
+    /**
+     * @brief Mark the value as changed in Redis.
+     * 
+     * Called from the `RedisHandler` subscriber thread. Only records the event and bumps the atomic version,
+     * value itself is fetched lazily by the reading thread. Echoes of own writes are ignored.
+     * 
+     * @param event The event of the notification, e.g. `rpush` or `del`. Empty if it is not known.
+     */
+    void markChanged(std::string_view event = std::string_view());
+
+    /**
+     * @brief Mark the value as changed in Redis, with the new encoded value published by its writer.
+     * 
+     * Called from the `RedisHandler` subscriber thread in publish mode. The value is stored and applied lazily
+     * by the reading thread, so no fetch is needed. Echoes of own writes are ignored.
+     * 
+     * @param encoded The published encoded value.
+     */
+    void markPublished(std::string_view encoded);
+
+    /**
+     * @brief Mark the local copy as up to date without fetching it from Redis.
+     */
+    void markFetched();
+
+    /**
+     * @brief Check if the value has changed in Redis since the last fetch.
+     * 
+     * @return `true` if the value has changed, `false` otherwise.
+     */
+    bool isChanged();
+
     /**
      * @brief Convert the std::any value of the cache to a string.
      * 
@@ -123,216 +580,610 @@ public:
      * @return The value of the cache as a std::any object.
      */
     virtual std::any getValue() = 0;
+
+    /**
+     * @brief Get the value of the cache without blocking on Redis.
+     * 
+     * If the value has not changed, returned future is ready. Otherwise the fetch is started right away and
+     * the local copy is updated by the thread calling `get` on the returned future, which has to be the thread
+     * reading the value. The value has to outlive the returned future.
+     * 
+     * @return Future of the value of the cache as a std::any object.
+     */
+    std::future<std::any> getValueAsync();
+
+    /**
+     * @brief Get the value of the cache from a coroutine.
+     * 
+     * Resumes the coroutine without suspending if the value has not changed, otherwise after the value is fetched.
+     * Local copy is updated by the resumed coroutine. The value has to outlive the operation.
+     * 
+     * @return Awaitable of the value of the cache as a std::any object.
+     */
+    CacheAwaitable<std::any> fetchAwait();
 };
+
 /**
- * @brief A cache value that contains a string.
+ * @brief An abstract cache value that contains a single scalar stored as Redis string.
  * 
- * This class inherits from the `AbstractCacheValue` base class and encapsulates a string value. It provides an 
- * implementation of the `getValue` method, which retrieves the string value as a `std::any` object, and the 
- * `setValue` method, which sets the string value. The `addValueToRedis_` method, which is used to add the 
- * value to a Redis database, is also overridden in this class.
+ * This class inherits from the `AbstractCacheValue` base class and serves as the base class for cache values
+ * stored with `SET` and `GET`, like strings, integers or floats. Derived classes only convert the value to and
+ * from its representation in Redis, by implementing `encodeValue_` and `decodeValue_`. Representation of scalar
+ * values allows fetching many of them with a single `MGET`.
  */
-class CacheString : public AbstractCacheValue{
+class ScalarCacheValue : public AbstractCacheValue{
+protected:
     /**
-     * @brief The string value stored in the cache.
+     * @brief Whether the value has a write waiting in the `WriteBehindQueue`.
      */
-    std::string value_;
+    std::atomic<bool> write_pending_;
 
     /**
-     * @brief Add the string value to a Redis database.
+     * @brief Compression of the value stored in Redis, with its counters.
+     */
+    Compression compression_;
+
+    /**
+     * @brief Whether the value last fetched or written is stored compressed, by this or another writer.
+     */
+    bool stored_packed_;
+
+    /**
+     * @brief Decode the value fetched from Redis, unless the value has a pending write.
+     * 
+     * Compressed value is decompressed first, whether or not this value compresses its own writes.
+     * 
+     * @param encoded The value stored in Redis.
+     */
+    void applyEncoded_(const std::string& encoded);
+
+    /**
+     * @brief Register the value in its topic. Called by constructors of derived classes, once the value is initialized.
+     */
+    void registerInTopic_();
+
+    /**
+     * @brief Drop the pending write of the value, which would write its old key again once the key is removed.
+     */
+    void discardPendingWrite_();
+
+    /**
+     * @brief Remove the value from Redis, dropping its pending write first.
+     * 
+     * This method is overridden from the `AbstractCacheValue` base class.
+     */
+    void removeValueFromRedis_() override;
+
+    /**
+     * @brief Add the encoded value to a Redis database.
      * 
      * This method is overridden from the `AbstractCacheValue` base class.
      */
     void addValueToRedis_() override;
 
-public:
     /**
-     * @brief Construct a new `CacheString` object.
+     * @brief Fetch the encoded value from Redis and decode it.
      * 
-     * This constructor initializes the `id_` and `topic_` members of the base class with the given parameters
-     * and setting default value which is empty string.
-     *  
-     * @param id The ID of the cache value.
-     * @param topic_path The topic path of the cache value.
+     * This method is overridden from the `AbstractCacheValue` base class.
      */
-    CacheString(std::string id, std::string topic_path);
+    void fetchValue_() override;
 
     /**
-     * @brief Construct a new `CacheString` object with an initial value.
+     * @brief Start fetching the encoded value from Redis asynchronously.
      * 
-     * This constructor initializes the `id_` and `topic_` members of the base class and the `value_` member
-     * of this class with the given parameters.
+     * This method is overridden from the `AbstractCacheValue` base class.
+     */
+    void fetchValueAsync_(FetchDone done) override;
+
+    /**
+     * @brief Replace the value with a value published by its writer.
      * 
-     * @param id The ID of the cache value.
-     * @param topic_path The topic path of the cache value.
-     * @param value The initial string value.
+     * This method is overridden from the `AbstractCacheValue` base class.
      */
-    CacheString(std::string id, std::string topic_path, std::string value);
+    void applyPublished_(const std::string& encoded) override;
 
     /**
-     * @brief Destroy the `CacheString` object.
+     * @brief Get the command writing an encoded value, compressed if it reaches the compression threshold.
+     * 
+     * It is a plain `SET`, or a script running `SET` and `PUBLISH` of the value atomically if
+     * `RedisConfig::publish_values` is enabled, so the order of messages matches the order of writes.
+     * 
+     * @param encoded The encoded value.
+     * @return The command with its arguments.
      */
-    ~CacheString()=default;
+    std::vector<std::string> writeCommand_(const std::string& encoded);
 
     /**
-     * @brief Get the string value of the cache.
+     * @brief Get the number of echoes of a command returned by `writeCommand_`.
+     * 
+     * @return 2 if the value is published, because own message arrives as well, 1 otherwise.
+     */
+    static std::uint32_t writeEchoes_();
+
+    /**
+     * @brief Add the encoded value to a Redis database asynchronously.
+     * 
+     * @param done Callback called when Redis confirms the write.
+     */
+    void addValueToRedisAsync_(AsyncDone done);
+
+    /**
+     * @brief Get keyspace event class of string commands.
      * 
      * This method is overridden from the `AbstractCacheValue` base class.
+     */
+    char keyspaceEventClass_() const override;
+
+    /**
+     * @brief Encode the value to its representation in Redis. To be implemented by derived classes.
      * 
-     * @return The string value of the cache as a `std::any` object.
+     * @return The encoded value.
      */
-    std::any getValue() override;
+    virtual std::string encodeValue_() const = 0;
+
+    /**
+     * @brief Decode the value from its representation in Redis. To be implemented by derived classes.
+     * 
+     * @param encoded The encoded value.
+     */
+    virtual void decodeValue_(const std::string& encoded) = 0;
+
+    /**
+     * @brief Run a command modifying the value on the server, whose reply is the new value.
+     * 
+     * Pending write of the value is flushed first, so it does not overwrite the result. The echo of the command
+     * is suppressed and the local copy is considered fetched, because the caller updates it from the reply.
+     * 
+     * @param command Callable running the command through the `sw::redis::Redis` and with the key it is given.
+     * @return The reply of the command.
+     */
+    template <typename Command>
+    auto modifyOnServer_(Command&& command){
+        if (write_pending_.load(std::memory_order_acquire))
+            RedisHandler::getInstance().flush();
+        std::uint64_t epoch = epoch_();
+        std::uint64_t version = version_.load(std::memory_order_acquire);
+        decltype(command(std::declval<sw::redis::Redis&>(), std::string())) reply{};
+        writeWithEcho_([&](sw::redis::Redis& redis){
+            reply = command(redis, redisKey_());
+        });
+        fetched_version_ = version;
+        fetched_epoch_ = epoch;
+        return reply;
+    }
+
+    /**
+     * @brief Give the `Topic` class friend access.
+     * 
+     * This allows the `Topic` to decode values fetched with a single `MGET`.
+     */
+    friend class Topic;
+
+    /**
+     * @brief Give the `WriteBehindQueue` class friend access.
+     * 
+     * This allows the queue to track pending writes and their echoes.
+     */
+    friend class WriteBehindQueue;
+
+    /**
+     * @brief Give the `WriteBatch` class friend access.
+     * 
+     * This allows the batch to write values with the same command as the value itself.
+     */
+    friend class WriteBatch;
+
+public:
+    /**
+     * @brief Construct a new `ScalarCacheValue` object.
+     * 
+     * This constructor initializes the `id_` and `topic_` members of the base class with the given parameters.
+     * 
+     * @param id The ID of the cache value.
+     * @param topic_path The topic path of the cache value.
+     */
+    ScalarCacheValue(std::string id, std::string topic_path);
+
+    /**
+     * @brief Destroy the `ScalarCacheValue` object.
+     * 
+     * Flushes the `WriteBehindQueue` if the value has a pending write.
+     */
+    virtual ~ScalarCacheValue();
 
     /**
-     * @brief Set the string value of the cache.
+     * @brief Set the minimal size of the encoded value which is stored compressed with LZ4.
      * 
-     * This method sets the `value_` member of this class to the given string value and
-     * updates the value in the Redis database.
+     * Applies to following writes, defaults to `RedisConfig::compression_threshold`. Readers decompress values
+     * regardless of their own threshold.
      * 
-     * @param value The new string value.
+     * @param threshold The minimal size in bytes, 0 disables compression.
      */
-    void setValue(std::string value);
+    void setCompressionThreshold(std::size_t threshold);
+
+    /**
+     * @brief Get counters of compression of the value, e.g. compression ratio and time spent.
+     * 
+     * @return The counters.
+     */
+    CompressionStats getCompressionStats() const;
 };
 
 /**
- * @brief A cache value that contains an integer.
+ * @brief A scalar cache value of type `T`, converted to and from its representation in Redis by `Codec`.
+ * 
+ * This class inherits from the `ScalarCacheValue` base class, which implements fetching, writing and refreshing
+ * of the encoded value for all scalar types. Codec is selected at compile time, so reads through `view` are
+ * direct typed accesses. New value types only need a codec, see `ValueCodec`. Arithmetic types with `DefaultCodec`
+ * also provide atomic modifications on the server, e.g. `add`.
  * 
- * This class inherits from the `AbstractCacheValue` base class and encapsulates an integer value. It provides an 
- * implementation of the `getValue` method, which retrieves the integer value as a `std::any` object, and the 
- * `setValue` method, which sets the integer value. The `addValueToRedis_` method, which is used to add the 
- * value to a Redis database, is also overridden in this class.
+ * @tparam T Type of the value.
+ * @tparam Codec Codec of the value, `DefaultCodec<T>` unless given.
  */
-class CacheInt : public AbstractCacheValue {
+template <typename T, typename Codec = DefaultCodec<T>>
+requires ValueCodec<Codec, T>
+class CacheValue : public ScalarCacheValue {
     /**
-     * @brief The integer value stored in the cache.
+     * @brief The value stored in the cache.
      */
-    int value_;
+    T value_;
 
     /**
-     * @brief Add the integer value to a Redis database.
+     * @brief Encode the value to its representation in Redis.
+     * 
+     * This method is overridden from the `ScalarCacheValue` base class.
+     */
+    std::string encodeValue_() const override {
+        return Codec::encode(value_);
+    }
+
+    /**
+     * @brief Decode the value from its representation in Redis.
+     * 
+     * This method is overridden from the `ScalarCacheValue` base class.
+     */
+    void decodeValue_(const std::string& encoded) override {
+        value_ = Codec::decode(encoded);
+    }
+
+    /**
+     * @brief Reset the value to its default, used when the key is deleted.
+     * 
+     * This method is overridden from the `ScalarCacheValue` base class.
+     */
+    void clearValue_() override {
+        applyEncoded_(Codec::encode(T{}));
+    }
+
+    /**
+     * @brief Number of known bytes fetched before an appended suffix, to check it continues local copy.
+     */
+    static constexpr std::size_t append_overlap_ = 16;
+
+    /**
+     * @brief Fetch only the appended suffix of a string with `GETRANGE`.
+     * 
+     * Suffix is fetched together with the last few bytes of local copy, and applied only if they match, so
+     * a change interleaving with the appends falls back to a full fetch. Values of other types are fetched whole.
      * 
      * This method is overridden from the `AbstractCacheValue` base class.
      */
-    void addValueToRedis_() override;
+    bool fetchDelta_(KeyEvent event) override {
+        if constexpr (!StringRangeCodec<Codec, T>) {
+            return false;
+        }
+        else {
+            if (event != KeyEvent::Appended || value_.empty() || write_pending_.load(std::memory_order_acquire))
+                return false;
+            std::size_t overlap = std::min(value_.size(), append_overlap_);
+            std::string fetched = RedisHandler::getInstance().getRedis()->getrange(redisKey_(),
+                static_cast<long long>(value_.size() - overlap), -1);
+            if (fetched.size() < overlap || value_.compare(value_.size() - overlap, overlap, fetched, 0, overlap) != 0)
+                return false;
+            value_.append(fetched, overlap);
+            return true;
+        }
+    }
 
-public:
     /**
-     * @brief Construct a new `CacheInt` object.
+     * @brief Convert the reply of `INCRBY` or `INCRBYFLOAT` to the value.
      * 
-     * This constructor initializes the `id_` and `topic_` members of the base class with the given parameters
-     * and sets default value which is 0.
+     * Result outside the range of `T` cannot be kept in local copy, so the value is fetched whole on the next read.
      * 
-     * @param id The ID of the cache value.
-     * @param topic_path The topic path of the cache value.
+     * @param reply The new value on the server.
+     * @return The new value.
+     * @throws std::out_of_range If the new value does not fit in `T`.
      */
-    CacheInt(std::string id, std::string topic_path);
+    template <typename Reply>
+    T fromServerReply_(Reply reply){
+        bool in_range;
+        if constexpr (std::is_integral_v<T>)
+            in_range = std::in_range<T>(reply);
+        else
+            in_range = std::isfinite(reply) && reply >= std::numeric_limits<T>::lowest() && reply <= std::numeric_limits<T>::max();
+        if (!in_range) {
+            forceFetch_();
+            throw std::out_of_range("Value " + redisKey_() + " on the server is out of range of its type");
+        }
+        return static_cast<T>(reply);
+    }
 
     /**
-     * @brief Construct a new `CacheInt` object with an initial value.
+     * @brief Convert the text reply of `INCRBYFLOAT` to the value, see `fromServerReply_`.
      * 
-     * This constructor initializes the `id_` and `topic_` members of the base class and the `value_` member
-     * of this class with the given parameters.
+     * @param reply The new value on the server, as decimal text.
+     * @return The new value.
+     * @throws std::out_of_range If the new value does not fit in `T`.
+     */
+    T fromServerText_(const std::string& reply){
+        // Text which cannot be parsed, e.g. too big for a double, leaves the value infinite, so it is rejected.
+        double value = std::numeric_limits<double>::infinity();
+        std::from_chars(reply.data(), reply.data() + reply.size(), value);
+        return fromServerReply_(value);
+    }
+
+    /**
+     * @brief Give the `WriteBatch` class friend access.
+     * 
+     * This allows the batch to update local copy once the batch is committed.
+     */
+    friend class WriteBatch;
+
+public:
+    /**
+     * @brief Construct a new `CacheValue` object with the default value of `T` and write it to Redis.
      * 
      * @param id The ID of the cache value.
      * @param topic_path The topic path of the cache value.
-     * @param value The initial integer value.
      */
-    CacheInt(std::string id, std::string topic_path, int value);
+    CacheValue(std::string id, std::string topic_path) : CacheValue(id, topic_path, T{}) {}
 
     /**
-     * @brief Destroy the `CacheInt` object.
+     * @brief Construct a new `CacheValue` object with an initial value and write it to Redis.
+     * 
+     * @param id The ID of the cache value.
+     * @param topic_path The topic path of the cache value.
+     * @param value The initial value.
      */
-    ~CacheInt() = default;
+    CacheValue(std::string id, std::string topic_path, T value) : ScalarCacheValue(id, topic_path), value_(std::move(value)) {
+        registerInTopic_();
+        addValueToRedis_();
+    }
 
     /**
-     * @brief Get the integer value of the cache.
+     * @brief Construct a new `CacheValue` object bound to an existing key, without writing to Redis.
      * 
-     * This method is overridden from the `AbstractCacheValue` base class.
+     * The value is fetched lazily on the first read, so creating the object costs no round trip.
+     * Until then, or if the key does not exist, the value is the default value of `T`.
      * 
-     * @return The integer value of the cache as a `std::any` object.
+     * @param id The ID of the cache value.
+     * @param topic_path The topic path of the cache value.
      */
-    std::any getValue() override;
+    CacheValue(std::string id, std::string topic_path, AttachTag) : ScalarCacheValue(id, topic_path), value_() {
+        registerInTopic_();
+        markStale_();
+    }
 
     /**
-     * @brief Set the integer value of the cache.
+     * @brief Destroy the `CacheValue` object.
+     */
+    ~CacheValue() = default;
+
+    /**
+     * @brief Get the value of the cache.
      * 
-     * This method sets the `value_` member of this class to the given integer value and
-     * updates the value in the Redis.
+     * This method is overridden from the `AbstractCacheValue` base class.
      * 
-     * @param value The new integer value.
+     * @return The value of the cache as a `std::any` object.
      */
-    void setValue(int value);
-};
-/**
- * @brief A cache value that contains a float.
- * 
- * This class inherits from the `AbstractCacheValue` base class and encapsulates a float value. It provides an 
- * implementation of the `getValue` method, which retrieves the float value as a `std::any` object, and the 
- * `setValue` method, which sets the float value. The `addValueToRedis_` method, which is used to add the 
- * value to a Redis database, is also overridden in this class.
- */
-class CacheFloat : public AbstractCacheValue {
+    std::any getValue() override {
+        syncValue_();
+        return value_;
+    }
+
     /**
-     * @brief The float value stored in the cache.
+     * @brief Get a read-only view of the value in the cache, without copying it or going through `std::any`.
+     * 
+     * Checks if value in redis has changed, like `getValue`. Reference stays valid until the next read or write
+     * of the value, which may replace the local copy, so it should not be kept across them.
+     * 
+     * @return Reference to the local copy of the value.
      */
-    float value_;
+    const T& view() {
+        syncValue_();
+        return value_;
+    }
 
     /**
-     * @brief Add the float value to a Redis database.
+     * @brief Set the value of the cache.
      * 
-     * This method is overridden from the `AbstractCacheValue` base class.
+     * This method sets the `value_` member of this class to the given value and updates the value in the Redis.
+     * 
+     * @param value The new value.
      */
-    void addValueToRedis_() override;
+    void setValue(T value){
+        value_ = std::move(value);
+        addValueToRedis_();
+    }
 
-public:
     /**
-     * @brief Construct a new `CacheFloat` object.
+     * @brief Set the value of the cache without blocking on Redis.
      * 
-     * This constructor initializes the `id_` and `topic_` members of the base class with the given parameters
-     * and sets default value which is 0.0.
+     * This method sets the `value_` member of this class to the given value and starts updating the value
+     * in the Redis database. The object has to outlive the write.
      * 
-     * @param id The ID of the cache value.
-     * @param topic_path The topic path of the cache value.
+     * @param value The new value.
+     * @return Future which is ready when Redis confirms the write.
      */
-    CacheFloat(std::string id, std::string topic_path);
+    std::future<void> setValueAsync(T value){
+        value_ = std::move(value);
+        return futureOf_([&](AsyncDone done){
+            addValueToRedisAsync_(std::move(done));
+        });
+    }
 
     /**
-     * @brief Construct a new `CacheFloat` object with an initial value.
+     * @brief Set the value of the cache from a coroutine.
      * 
-     * This constructor initializes the `id_` and `topic_` members of the base class and the `value_` member
-     * of this class with the given parameters.
+     * Coroutine is resumed when Redis confirms the write. The object has to outlive the write.
      * 
-     * @param id The ID of the cache value.
-     * @param topic_path The topic path of the cache value.
-     * @param value The initial float value.
+     * @param value The new value.
+     * @return Awaitable of the write.
      */
-    CacheFloat(std::string id, std::string topic_path, float value);
+    CacheAwaitable<void> setValueAwait(T value){
+        return CacheAwaitable<void>(false, [this, value = std::move(value)](AsyncDone done){
+            value_ = value;
+            addValueToRedisAsync_(std::move(done));
+        }, [](){});
+    }
 
     /**
-     * @brief Destroy the `CacheFloat` object.
+     * @brief Add to the value atomically on the server, with `INCRBY` for integers and `INCRBYFLOAT` for floats.
+     * 
+     * Local copy is updated from the reply, so concurrent additions from other processes are not lost.
+     * Available with `DefaultCodec` only, which stores numbers as decimal text.
+     * 
+     * @param delta The added value, may be negative.
+     * @return The new value.
+     * @throws std::out_of_range If the new value on the server does not fit in `T`.
      */
-    ~CacheFloat() = default;
+    T add(T delta) requires ServerArithmeticCodec<Codec, T> {
+        if constexpr (std::is_integral_v<T>) {
+            value_ = fromServerReply_(modifyOnServer_([&](sw::redis::Redis& redis, const std::string& key){
+                return redis.incrby(key, delta);
+            }));
+        }
+        else {
+            // Increment is sent as the shortest text which reads back as the same value, like the value itself.
+            value_ = fromServerText_(modifyOnServer_([&](sw::redis::Redis& redis, const std::string& key){
+                return redis.command<std::string>("INCRBYFLOAT", key, Codec::encode(delta));
+            }));
+        }
+        return value_;
+    }
 
     /**
-     * @brief Get the float value of the cache.
-     * 
-     * This method is overridden from the `AbstractCacheValue` base class.
+     * @brief Increment the value atomically on the server, see `add`.
      * 
-     * @return The float value of the cache as a `std::any` object.
+     * @param delta The increment.
+     * @return The new value.
      */
-    std::any getValue() override;
+    T increment(T delta = T{1}) requires ServerArithmeticCodec<Codec, T> {
+        return add(delta);
+    }
 
     /**
-     * @brief Set the float value of the cache.
+     * @brief Decrement the value atomically on the server, with `DECRBY` for integers and `INCRBYFLOAT` for floats.
      * 
-     * This method sets the `value_` member of this class to the given float value and
-     * updates the value in the Redis.
+     * Local copy is updated from the reply, so concurrent decrements from other processes are not lost.
      * 
-     * @param value The new float value.
+     * @param delta The decrement.
+     * @return The new value.
+     * @throws std::out_of_range If the new value on the server does not fit in `T`.
      */
-    void setValue(float value);
+    T decrement(T delta = T{1}) requires ServerArithmeticCodec<Codec, T> {
+        if constexpr (std::is_integral_v<T>) {
+            value_ = fromServerReply_(modifyOnServer_([&](sw::redis::Redis& redis, const std::string& key){
+                return redis.decrby(key, delta);
+            }));
+            return value_;
+        }
+        else {
+            return add(-delta);
+        }
+    }
+
+    /**
+     * @brief Append to the string on the server with `APPEND`, without sending or fetching the whole value.
+     * 
+     * Local copy is brought up to date first and the suffix is appended to it. Reply of `APPEND` is the new
+     * length only, so if it does not match local copy, a write of another process came in between and the value
+     * is fetched whole on the next read. Readers notified by the `append` keyspace event fetch only the suffix.
+     * Available with `DefaultCodec<std::string>` only, and not with compression, which would corrupt the value.
+     * Value stored compressed by another writer is recognized by the header of the last fetched value.
+     * 
+     * @param suffix The appended bytes.
+     * @return The new length of the string.
+     * @throws std::logic_error If the value is compressed, or stored compressed by another writer.
+     */
+    std::size_t append(const std::string& suffix) requires StringRangeCodec<Codec, T> {
+        syncValue_();
+        if (compression_.getThreshold() != 0 || stored_packed_)
+            throw std::logic_error("Cannot append to compressed value " + redisKey_());
+        long long length = modifyOnServer_([&](sw::redis::Redis& redis, const std::string& key){
+            return redis.append(key, suffix);
+        });
+        value_ += suffix;
+        if (static_cast<std::size_t>(length) != value_.size())
+            forceFetch_();
+        return static_cast<std::size_t>(length);
+    }
+
+    /**
+     * @brief Overwrite part of the string on the server with `SETRANGE`, without sending or fetching the whole value.
+     * 
+     * String is padded with zero bytes if the offset is past its end. Local copy is updated like in `append`,
+     * readers fetch the whole value, because the keyspace event does not carry the offset.
+     * 
+     * @param offset Position of the first overwritten byte.
+     * @param value The written bytes.
+     * @return The new length of the string.
+     * @throws std::logic_error If the value is compressed, or stored compressed by another writer.
+     */
+    std::size_t setRange(std::size_t offset, const std::string& value) requires StringRangeCodec<Codec, T> {
+        syncValue_();
+        if (compression_.getThreshold() != 0 || stored_packed_)
+            throw std::logic_error("Cannot overwrite range of compressed value " + redisKey_());
+        long long length = modifyOnServer_([&](sw::redis::Redis& redis, const std::string& key){
+            return redis.setrange(key, static_cast<long long>(offset), value);
+        });
+        if (value_.size() < offset + value.size())
+            value_.resize(offset + value.size(), '\0');
+        value_.replace(offset, value.size(), value);
+        if (static_cast<std::size_t>(length) != value_.size())
+            forceFetch_();
+        return static_cast<std::size_t>(length);
+    }
+
+    /**
+     * @brief Get part of the string from local copy, with the indexes of `GETRANGE`.
+     * 
+     * Both ends are inclusive and negative indexes count from the end of the string. Checks if value in redis
+     * has changed, like `view`, and the returned view is valid as long as a reference returned by `view`.
+     * 
+     * @param start Index of the first byte.
+     * @param end Index of the last byte.
+     * @return View of the bytes, empty if the range is empty.
+     */
+    std::string_view getRange(long long start, long long end) requires StringRangeCodec<Codec, T> {
+        syncValue_();
+        long long size = static_cast<long long>(value_.size());
+        if (start < 0)
+            start = std::max(size + start, 0LL);
+        if (end < 0)
+            end = std::max(size + end, 0LL);
+        end = std::min(end, size - 1);
+        if (start > end)
+            return {};
+        return std::string_view(value_).substr(static_cast<std::size_t>(start), static_cast<std::size_t>(end - start + 1));
+    }
 };
 
+/**
+ * @brief A cache value that contains a string, stored as raw bytes.
+ */
+using CacheString = CacheValue<std::string>;
+
+/**
+ * @brief A cache value that contains an integer, stored as decimal text.
+ */
+using CacheInt = CacheValue<int>;
+
+/**
+ * @brief A cache value that contains a float, stored as decimal text.
+ */
+using CacheFloat = CacheValue<float>;
+
 /**
  * @brief An abstract cache value that contains a container.
  * 
@@ -341,6 +1192,30 @@ public:
  * implemented by the derived classes: `clear`, `size`, `contains`, and `empty`.
  */
 class ContainerCacheValue : public AbstractCacheValue{
+protected:
+    /**
+     * @brief Queue the command fetching the container into a pipeline. To be implemented by derived classes.
+     * 
+     * @param pipeline The pipeline to queue the command into.
+     */
+    virtual void queueFetch_(sw::redis::Pipeline& pipeline) = 0;
+
+    /**
+     * @brief Replace local copy with the reply of the command queued by `queueFetch_`. To be implemented by
+     * derived classes.
+     * 
+     * @param replies Replies of the executed pipeline.
+     * @param index Index of the reply to the command queued by `queueFetch_`.
+     */
+    virtual void applyFetch_(sw::redis::QueuedReplies& replies, std::size_t index) = 0;
+
+    /**
+     * @brief Give the `Topic` class friend access.
+     * 
+     * This allows the `Topic` to fetch many containers in a single pipeline.
+     */
+    friend class Topic;
+
 public:
     /**
      * @brief Construct a new `ContainerCacheValue` object.
@@ -418,6 +1293,82 @@ class CacheList : public ContainerCacheValue{
      */
     void addValueToRedis_() override;
 
+    /**
+     * @brief Fetch the list of strings from Redis.
+     * 
+     * This method is overridden from the `ContainerCacheValue` base class.
+     */
+    void fetchValue_() override;
+
+    /**
+     * @brief Start fetching the list of strings from Redis asynchronously.
+     * 
+     * This method is overridden from the `ContainerCacheValue` base class.
+     */
+    void fetchValueAsync_(FetchDone done) override;
+
+    /**
+     * @brief Fetch only the pushed or popped part of the list.
+     * 
+     * Pushed elements are fetched together with the length and both ends of the list in a transaction, pops only
+     * fetch the length and the ends. Delta is applied only if the ends match local copy, so a change interleaving
+     * with the recorded ones falls back to a full fetch.
+     * 
+     * This method is overridden from the `ContainerCacheValue` base class.
+     */
+    bool fetchDelta_(KeyEvent event) override;
+
+    /**
+     * @brief Add a string to the end of the list and start updating value in Redis.
+     * 
+     * @param value The string to add.
+     * @param done Callback called when Redis confirms the write.
+     */
+    void rpushAsync_(std::string value, AsyncDone done);
+
+    /**
+     * @brief Add a string to the front of the list and start updating value in Redis.
+     * 
+     * @param value The string to add.
+     * @param done Callback called when Redis confirms the write.
+     */
+    void lpushAsync_(std::string value, AsyncDone done);
+
+    /**
+     * @brief Get keyspace event class of list commands.
+     * 
+     * This method is overridden from the `ContainerCacheValue` base class.
+     */
+    char keyspaceEventClass_() const override;
+
+    /**
+     * @brief Queue the command fetching the list of strings into a pipeline.
+     * 
+     * This method is overridden from the `ContainerCacheValue` base class.
+     */
+    void queueFetch_(sw::redis::Pipeline& pipeline) override;
+
+    /**
+     * @brief Replace the list of strings with the fetched reply.
+     * 
+     * This method is overridden from the `ContainerCacheValue` base class.
+     */
+    void applyFetch_(sw::redis::QueuedReplies& replies, std::size_t index) override;
+
+    /**
+     * @brief Clear the list of strings, used when the key is deleted.
+     * 
+     * This method is overridden from the `ContainerCacheValue` base class.
+     */
+    void clearValue_() override;
+
+    /**
+     * @brief Give the `WriteBatch` class friend access.
+     * 
+     * This allows the batch to update local copy once the batch is committed.
+     */
+    friend class WriteBatch;
+
 public:
     /**
      * @brief Construct a new `CacheList` object with an initial list.
@@ -431,6 +1382,17 @@ public:
      */
     CacheList(std::string id, std::string topic_path, std::list<std::string> value);
 
+    /**
+     * @brief Construct a new `CacheList` object bound to an existing key, without writing to Redis.
+     * 
+     * The list of strings is fetched lazily on the first read, so creating the object costs no round trip.
+     * Until then, or if the key does not exist, the value is an empty list.
+     * 
+     * @param id The ID of the cache value.
+     * @param topic_path The topic path of the cache value.
+     */
+    CacheList(std::string id, std::string topic_path, AttachTag);
+
     /**
      * @brief Destroy the `CacheList` object.
      */
@@ -446,11 +1408,21 @@ public:
      */
     std::any getValue() override;
 
+    /**
+     * @brief Get a read-only view of the list of strings in the cache, without copying it.
+     * 
+     * Checks if value in redis has changed, like `getValue`. Reference stays valid until the next read or write
+     * of the value, which may replace the local copy, so it should not be kept across them.
+     * 
+     * @return Reference to the local copy of the list of strings.
+     */
+    const std::list<std::string>& view();
+
     /**
      * @brief Set the list of strings in the cache.
      * 
      * This method sets the `value_` member of this class to the given list of strings and
-     * updates the list in the Redis.
+     * replaces the list in the Redis atomically, unless it is equal to the current list.
      * 
      * @param value The new list of strings.
      */
@@ -466,6 +1438,27 @@ public:
      */
     void rpush(std::string value);
 
+    /**
+     * @brief Add a string to the end of the list without blocking on Redis.
+     * 
+     * This method adds a string to the end of the `value_` list and starts updating value in Redis.
+     * The object has to outlive the write.
+     * 
+     * @param value The string to add.
+     * @return Future which is ready when Redis confirms the write.
+     */
+    std::future<void> rpushAsync(std::string value);
+
+    /**
+     * @brief Add a string to the end of the list from a coroutine.
+     * 
+     * Coroutine is resumed when Redis confirms the write. The object has to outlive the write.
+     * 
+     * @param value The string to add.
+     * @return Awaitable of the write.
+     */
+    CacheAwaitable<void> rpushAwait(std::string value);
+
     /**
      * @brief Add a string to the front of the list.
      * 
@@ -476,6 +1469,27 @@ public:
      */
     void lpush(std::string value);
 
+    /**
+     * @brief Add a string to the front of the list without blocking on Redis.
+     * 
+     * This method adds a string to the front of the `value_` list and starts updating value in Redis.
+     * The object has to outlive the write.
+     * 
+     * @param value The string to add.
+     * @return Future which is ready when Redis confirms the write.
+     */
+    std::future<void> lpushAsync(std::string value);
+
+    /**
+     * @brief Add a string to the front of the list from a coroutine.
+     * 
+     * Coroutine is resumed when Redis confirms the write. The object has to outlive the write.
+     * 
+     * @param value The string to add.
+     * @return Awaitable of the write.
+     */
+    CacheAwaitable<void> lpushAwait(std::string value);
+
     /**
      * @brief Remove and return a string from the end of the list.
      * 
@@ -557,6 +1571,64 @@ class CacheMap : public ContainerCacheValue{
      */
     void addValueToRedis_() override;
 
+    /**
+     * @brief Fetch the map of strings from Redis.
+     * 
+     * This method is overridden from the `ContainerCacheValue` base class.
+     */
+    void fetchValue_() override;
+
+    /**
+     * @brief Start fetching the map of strings from Redis asynchronously.
+     * 
+     * This method is overridden from the `ContainerCacheValue` base class.
+     */
+    void fetchValueAsync_(FetchDone done) override;
+
+    /**
+     * @brief Add a key-value pair to the map and start updating value in Redis.
+     * 
+     * @param key The key to add.
+     * @param value The value to add.
+     * @param done Callback called when Redis confirms the write.
+     */
+    void addKeyAsync_(std::string key, std::string value, AsyncDone done);
+
+    /**
+     * @brief Get keyspace event class of hash commands.
+     * 
+     * This method is overridden from the `ContainerCacheValue` base class.
+     */
+    char keyspaceEventClass_() const override;
+
+    /**
+     * @brief Queue the command fetching the map of strings into a pipeline.
+     * 
+     * This method is overridden from the `ContainerCacheValue` base class.
+     */
+    void queueFetch_(sw::redis::Pipeline& pipeline) override;
+
+    /**
+     * @brief Replace the map of strings with the fetched reply.
+     * 
+     * This method is overridden from the `ContainerCacheValue` base class.
+     */
+    void applyFetch_(sw::redis::QueuedReplies& replies, std::size_t index) override;
+
+    /**
+     * @brief Clear the map of strings, used when the key is deleted.
+     * 
+     * This method is overridden from the `ContainerCacheValue` base class.
+     */
+    void clearValue_() override;
+
+    /**
+     * @brief Give the `WriteBatch` class friend access.
+     * 
+     * This allows the batch to update local copy once the batch is committed.
+     */
+    friend class WriteBatch;
+
 public:
     /**
      * @brief Construct a new `CacheMap` object with an initial map.
@@ -570,6 +1642,17 @@ public:
      */
     CacheMap(std::string id, std::string topic_path, std::map<std::string, std::string> value);
 
+    /**
+     * @brief Construct a new `CacheMap` object bound to an existing key, without writing to Redis.
+     * 
+     * The map of strings is fetched lazily on the first read, so creating the object costs no round trip.
+     * Until then, or if the key does not exist, the value is an empty map.
+     * 
+     * @param id The ID of the cache value.
+     * @param topic_path The topic path of the cache value.
+     */
+    CacheMap(std::string id, std::string topic_path, AttachTag);
+
     /**
      * @brief Destroy the `CacheMap` object.
      */
@@ -585,11 +1668,21 @@ public:
      */
     std::any getValue() override;
 
+    /**
+     * @brief Get a read-only view of the map of strings in the cache, without copying it.
+     * 
+     * Checks if value in redis has changed, like `getValue`. Reference stays valid until the next read or write
+     * of the value, which may replace the local copy, so it should not be kept across them.
+     * 
+     * @return Reference to the local copy of the map of strings.
+     */
+    const std::map<std::string, std::string>& view();
+
     /**
      * @brief Set the map of strings in the cache.
      * 
      * This method sets the `value_` member of this class to the given map of strings and
-     * updates the map in the Redis.
+     * updates the map in the Redis. Only removed and changed fields are sent, in a single pipeline.
      * 
      * @param value The new map of strings.
      */
@@ -606,6 +1699,29 @@ public:
      */
     void addKey(std::string key, std::string value);
 
+    /**
+     * @brief Add a key-value pair to the map without blocking on Redis.
+     * 
+     * This method adds a key-value pair to the `value_` map and starts updating value in Redis.
+     * The object has to outlive the write.
+     * 
+     * @param key The key to add.
+     * @param value The value to add.
+     * @return Future which is ready when Redis confirms the write.
+     */
+    std::future<void> addKeyAsync(std::string key, std::string value);
+
+    /**
+     * @brief Add a key-value pair to the map from a coroutine.
+     * 
+     * Coroutine is resumed when Redis confirms the write. The object has to outlive the write.
+     * 
+     * @param key The key to add.
+     * @param value The value to add.
+     * @return Awaitable of the write.
+     */
+    CacheAwaitable<void> addKeyAwait(std::string key, std::string value);
+
     /**
      * @brief Erase a key-value pair from the map.
      * 
@@ -690,6 +1806,63 @@ private:
      */
     void addValueToRedis_() override;
 
+    /**
+     * @brief Fetch the set of strings from Redis.
+     * 
+     * This method is overridden from the `ContainerCacheValue` base class.
+     */
+    void fetchValue_() override;
+
+    /**
+     * @brief Start fetching the set of strings from Redis asynchronously.
+     * 
+     * This method is overridden from the `ContainerCacheValue` base class.
+     */
+    void fetchValueAsync_(FetchDone done) override;
+
+    /**
+     * @brief Add a string to the set and start updating value in Redis.
+     * 
+     * @param val The string to add.
+     * @param done Callback called when Redis confirms the write.
+     */
+    void addValueAsync_(std::string val, AsyncDone done);
+
+    /**
+     * @brief Get keyspace event class of set commands.
+     * 
+     * This method is overridden from the `ContainerCacheValue` base class.
+     */
+    char keyspaceEventClass_() const override;
+
+    /**
+     * @brief Queue the command fetching the set of strings into a pipeline.
+     * 
+     * This method is overridden from the `ContainerCacheValue` base class.
+     */
+    void queueFetch_(sw::redis::Pipeline& pipeline) override;
+
+    /**
+     * @brief Replace the set of strings with the fetched reply.
+     * 
+     * This method is overridden from the `ContainerCacheValue` base class.
+     */
+    void applyFetch_(sw::redis::QueuedReplies& replies, std::size_t index) override;
+
+    /**
+     * @brief Clear the set of strings, used when the key is deleted.
+     * 
+     * This method is overridden from the `ContainerCacheValue` base class.
+     */
+    void clearValue_() override;
+
+    /**
+     * @brief Give the `WriteBatch` class friend access.
+     * 
+     * This allows the batch to update local copy once the batch is committed.
+     */
+    friend class WriteBatch;
+
 public:
     /**
      * @brief Construct a new `CacheSet` object with an initial set.
@@ -703,6 +1876,17 @@ public:
      */
     CacheSet(std::string id, std::string topic_path, std::set<std::string> value);
 
+    /**
+     * @brief Construct a new `CacheSet` object bound to an existing key, without writing to Redis.
+     * 
+     * The set of strings is fetched lazily on the first read, so creating the object costs no round trip.
+     * Until then, or if the key does not exist, the value is an empty set.
+     * 
+     * @param id The ID of the cache value.
+     * @param topic_path The topic path of the cache value.
+     */
+    CacheSet(std::string id, std::string topic_path, AttachTag);
+
     /**
      * @brief Destroy the `CacheSet` object.
      */
@@ -718,11 +1902,21 @@ public:
      */
     std::any getValue() override;
 
+    /**
+     * @brief Get a read-only view of the set of strings in the cache, without copying it.
+     * 
+     * Checks if value in redis has changed, like `getValue`. Reference stays valid until the next read or write
+     * of the value, which may replace the local copy, so it should not be kept across them.
+     * 
+     * @return Reference to the local copy of the set of strings.
+     */
+    const std::set<std::string>& view();
+
     /**
      * @brief Set the set of strings in the cache.
      * 
      * This method sets the `value_` member of this class to the given set of strings and
-     * updates the set in the Redis.
+     * updates the set in the Redis. Only removed and added strings are sent, in a single pipeline.
      * 
      * @param value The new set of strings.
      */
@@ -738,6 +1932,27 @@ public:
      */
     void addValue(std::string val);
 
+    /**
+     * @brief Add a string to the set without blocking on Redis.
+     * 
+     * This method adds a string to the `value_` set and starts updating value in Redis.
+     * The object has to outlive the write.
+     * 
+     * @param val The string to add.
+     * @return Future which is ready when Redis confirms the write.
+     */
+    std::future<void> addValueAsync(std::string val);
+
+    /**
+     * @brief Add a string to the set from a coroutine.
+     * 
+     * Coroutine is resumed when Redis confirms the write. The object has to outlive the write.
+     * 
+     * @param val The string to add.
+     * @return Awaitable of the write.
+     */
+    CacheAwaitable<void> addValueAwait(std::string val);
+
     /**
      * @brief Remove a string from the set.
      * 
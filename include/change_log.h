@@ -0,0 +1,185 @@
+#ifndef CHANGE_LOG_H
+#define CHANGE_LOG_H
+
+#include <sw/redis++/redis++.h>
+#include <sw/redis++/async_redis++.h>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+/**
+ * @brief A change log of topics kept in Redis Streams, used as invalidation backend in `InvalidationMode::ChangeLog`.
+ * 
+ * Writers append an entry with the ID of every written value to the stream of its topic, entry ID of the stream
+ * is the version of the change. A background thread reads the streams of subscribed topics with `XREAD` from the
+ * last read entry, so changes made while the connection was down are read after it is restored and only the
+ * changed values are fetched again. If the entries were already trimmed, the whole topic is marked as changed.
+ */
+class ChangeLog {
+private:
+    /**
+     * @brief Redis connection used for appending entries.
+     */
+    sw::redis::Redis* redis_;
+
+    /**
+     * @brief Dedicated Redis connection blocked in `XREAD`.
+     */
+    sw::redis::Redis reader_;
+
+    /**
+     * @brief Approximate maximum number of entries kept in each stream.
+     */
+    long long max_length_;
+
+    /**
+     * @brief Maximum time the background thread blocks in `XREAD`, before it checks subscriptions and stopping.
+     */
+    std::chrono::milliseconds block_;
+
+    /**
+     * @brief Maximum number of entries read from one stream by a single `XREAD`.
+     */
+    long long read_count_;
+
+    /**
+     * @brief Streams of subscribed topics, mapping each stream key to the ID of the last read entry.
+     */
+    std::map<std::string, std::string> offsets_;
+
+    /**
+     * @brief Mutex guarding `offsets_`.
+     */
+    std::mutex mutex_;
+
+    /**
+     * @brief Whether the background thread should stop.
+     */
+    std::atomic<bool> stop_;
+
+    /**
+     * @brief Background thread reading the streams.
+     */
+    std::thread thread_;
+
+    /**
+     * @brief Loop of the background thread. Reconnects with a growing delay when reading fails.
+     */
+    void worker_();
+
+    /**
+     * @brief Read new entries of all subscribed streams and mark their values as changed.
+     * 
+     * @param resync Whether to check for trimmed entries first, e.g. after the connection was restored.
+     */
+    void read_(bool resync);
+
+    /**
+     * @brief Mark the whole topic as changed if entries after the offset were already trimmed from the stream.
+     * 
+     * @param key The key of the stream.
+     * @param offset The ID of the last read entry.
+     */
+    void checkTrimmed_(const std::string& key, const std::string& offset);
+
+    /**
+     * @brief Get the ID of the last entry of the stream, through the shared connection.
+     * 
+     * @param key The key of the stream.
+     * @return The ID, or `0-0` if the stream is empty.
+     */
+    std::string lastEntry_(const std::string& key);
+
+    /**
+     * @brief Compare two stream entry IDs.
+     * 
+     * @return Negative, zero or positive value if `lhs` is older, same or newer than `rhs`.
+     */
+    static int compareEntries_(const std::string& lhs, const std::string& rhs);
+
+public:
+    /**
+     * @brief Construct a new `ChangeLog` object and start its background thread.
+     * 
+     * @param redis Redis connection used for appending entries.
+     * @param options Options of the dedicated reading connection.
+     * @param max_length Approximate maximum number of entries kept in each stream.
+     * @param block Maximum time the background thread blocks in `XREAD`.
+     */
+    ChangeLog(sw::redis::Redis* redis, const sw::redis::ConnectionOptions& options, long long max_length, std::chrono::milliseconds block);
+
+    /**
+     * @brief Stop the background thread.
+     */
+    ~ChangeLog();
+
+    /**
+     * @brief Delete the copy constructor.
+     */
+    ChangeLog(const ChangeLog&) = delete;
+
+    /**
+     * @brief Delete the copy assignment operator.
+     */
+    ChangeLog& operator=(const ChangeLog&) = delete;
+
+    /**
+     * @brief Get the key of the stream of the topic.
+     * 
+     * @param topic_path The path of the topic.
+     * @return The key of the stream.
+     */
+    static std::string streamKey(const std::string& topic_path);
+
+    /**
+     * @brief Append a change of a value to the stream of its topic.
+     * 
+     * @param topic_path The path of the topic.
+     * @param id The ID of the changed value.
+     */
+    void append(const std::string& topic_path, const std::string& id);
+
+    /**
+     * @brief Queue appending a change of a value into a pipeline or transaction, after the write itself.
+     * 
+     * @param queued The pipeline or transaction.
+     * @param topic_path The path of the topic.
+     * @param id The ID of the changed value.
+     */
+    template <typename Queued>
+    void queueAppend(Queued& queued, const std::string& topic_path, const std::string& id){
+        std::vector<std::pair<std::string, std::string>> fields = {{"id", id}};
+        queued.xadd(streamKey(topic_path), "*", fields.begin(), fields.end(), max_length_, true);
+    }
+
+    /**
+     * @brief Start appending a change of a value on the asynchronous connection. Failure is only logged.
+     * 
+     * @param redis The asynchronous connection.
+     * @param topic_path The path of the topic.
+     * @param id The ID of the changed value.
+     */
+    void appendAsync(sw::redis::AsyncRedis& redis, const std::string& topic_path, const std::string& id);
+
+    /**
+     * @brief Start reading the stream of the topic from its current end.
+     * 
+     * @param topic_path The path of the topic.
+     */
+    void subscribe(const std::string& topic_path);
+
+    /**
+     * @brief Stop reading the stream of the topic.
+     * 
+     * @param topic_path The path of the topic.
+     */
+    void unsubscribe(const std::string& topic_path);
+};
+
+#endif // CHANGE_LOG_H
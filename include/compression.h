@@ -0,0 +1,163 @@
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief Snapshot of counters describing compression of a value.
+ */
+struct CompressionStats {
+    /**
+     * @brief Number of writes stored compressed.
+     */
+    std::uint64_t compressed_writes = 0;
+
+    /**
+     * @brief Total size of the values stored compressed, before compression.
+     */
+    std::uint64_t raw_bytes = 0;
+
+    /**
+     * @brief Total size of the values stored compressed, after compression. Divided by `raw_bytes` it is the compression ratio.
+     */
+    std::uint64_t compressed_bytes = 0;
+
+    /**
+     * @brief Total time spent compressing, including writes which were not smaller compressed.
+     */
+    std::uint64_t compress_nanoseconds = 0;
+
+    /**
+     * @brief Number of fetched or published values which were decompressed.
+     */
+    std::uint64_t decompressed_reads = 0;
+
+    /**
+     * @brief Total time spent decompressing.
+     */
+    std::uint64_t decompress_nanoseconds = 0;
+};
+
+/**
+ * @brief LZ4 compression of encoded values stored in Redis.
+ * 
+ * Compressed value starts with a header made of a marker, a format byte and the size of the original value, so
+ * readers recognize it regardless of their own settings. Values below the threshold, or not smaller compressed,
+ * are stored as they are. Values which happen to start with the marker are stored with a header as well, so they
+ * are never mistaken for compressed ones.
+ */
+class Compression {
+private:
+    /**
+     * @brief See `CompressionStats::compressed_writes`.
+     */
+    std::atomic<std::uint64_t> compressed_writes_;
+
+    /**
+     * @brief See `CompressionStats::raw_bytes`.
+     */
+    std::atomic<std::uint64_t> raw_bytes_;
+
+    /**
+     * @brief See `CompressionStats::compressed_bytes`.
+     */
+    std::atomic<std::uint64_t> compressed_bytes_;
+
+    /**
+     * @brief See `CompressionStats::compress_nanoseconds`.
+     */
+    std::atomic<std::uint64_t> compress_nanoseconds_;
+
+    /**
+     * @brief See `CompressionStats::decompressed_reads`.
+     */
+    std::atomic<std::uint64_t> decompressed_reads_;
+
+    /**
+     * @brief See `CompressionStats::decompress_nanoseconds`.
+     */
+    std::atomic<std::uint64_t> decompress_nanoseconds_;
+
+    /**
+     * @brief Minimal size of compressed values, 0 disables compression.
+     */
+    std::size_t threshold_;
+
+    /**
+     * @brief Check if the value starts with the header.
+     * 
+     * @param value The value stored in Redis.
+     * @return `true` if the value has the header, `false` otherwise.
+     */
+    static bool hasHeader_(const std::string& value);
+
+    /**
+     * @brief Add the header to a payload.
+     * 
+     * @param format The format byte.
+     * @param raw_size Size of the original value.
+     * @param payload The payload, stored or compressed original value.
+     * @param payload_size Size of the payload.
+     * @return The value to store in Redis.
+     */
+    static std::string withHeader_(char format, std::size_t raw_size, const char* payload, std::size_t payload_size);
+
+public:
+    /**
+     * @brief Construct a new `Compression` object.
+     * 
+     * @param threshold Minimal size of compressed values, 0 disables compression.
+     */
+    explicit Compression(std::size_t threshold);
+
+    /**
+     * @brief Set the minimal size of compressed values. Called from the thread writing the value.
+     * 
+     * @param threshold The minimal size, 0 disables compression.
+     */
+    void setThreshold(std::size_t threshold);
+
+    /**
+     * @brief Get the minimal size of compressed values.
+     * 
+     * @return The minimal size, 0 if compression is disabled.
+     */
+    std::size_t getThreshold() const;
+
+    /**
+     * @brief Convert an encoded value to the value stored in Redis, compressing it if it is big enough.
+     * 
+     * @param encoded The encoded value.
+     * @return The value to store in Redis.
+     */
+    std::string pack(const std::string& encoded);
+
+    /**
+     * @brief Check if a value stored in Redis has to be unpacked before decoding.
+     * 
+     * @param stored The value stored in Redis.
+     * @return `true` if the value has the header, `false` if it is the encoded value itself.
+     */
+    static bool isPacked(const std::string& stored);
+
+    /**
+     * @brief Convert a value stored in Redis with the header back to the encoded value.
+     * 
+     * @param stored The value stored in Redis.
+     * @return The encoded value.
+     * @throws std::runtime_error If the value is corrupted.
+     */
+    std::string unpack(const std::string& stored);
+
+    /**
+     * @brief Get a snapshot of the counters.
+     * 
+     * @return The counters.
+     */
+    CompressionStats getStats() const;
+};
+
+#endif // COMPRESSION_H
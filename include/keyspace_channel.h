@@ -0,0 +1,59 @@
+#ifndef KEYSPACE_CHANNEL_H
+#define KEYSPACE_CHANNEL_H
+
+#include <string_view>
+
+/**
+ * @brief A keyspace notification channel split into topic path and value id.
+ * 
+ * Channel of keyspace notification has form `__keyspace@<db>__:<topic_path>:<id>`. Parsed parts are views
+ * into the original channel, so parsing does not allocate and the channel has to outlive the result.
+ */
+struct KeyspaceChannel {
+    /**
+     * @brief The path of the topic.
+     */
+    std::string_view topic_path;
+
+    /**
+     * @brief The ID of the cache value.
+     */
+    std::string_view id;
+
+    /**
+     * @brief The event of the notification, e.g. `rpush` or `del`. Empty if the notification does not carry it.
+     * 
+     * Event is the payload of the notification, so it is not set by parsing the channel.
+     */
+    std::string_view event;
+
+    /**
+     * @brief Whether this is a message with the new value published by its writer, rather than a notification.
+     */
+    bool published = false;
+
+    /**
+     * @brief The encoded value carried by a published message.
+     */
+    std::string_view value;
+
+    /**
+     * @brief Split the channel in place.
+     * 
+     * @param channel The channel of keyspace notification.
+     * @param result The parsed channel, valid as long as `channel` is.
+     * @return `true` if the channel is a keyspace channel with topic path, `false` otherwise.
+     */
+    static bool parse(std::string_view channel, KeyspaceChannel& result);
+
+    /**
+     * @brief Split a key of the form `<topic_path>:<id>` in place, e.g. a key of a tracking invalidation.
+     * 
+     * @param key The key.
+     * @param result The parsed key, valid as long as `key` is.
+     * @return Always `true`, key without `:` is a topic path without ID.
+     */
+    static bool parseKey(std::string_view key, KeyspaceChannel& result);
+};
+
+#endif // KEYSPACE_CHANNEL_H
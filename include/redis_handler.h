@@ -2,19 +2,224 @@
 #define REDIS_HANDLER_H
 
 #include <sw/redis++/redis++.h>
+#include <sw/redis++/async_redis++.h>
 #include <map>
 #include <set>
 #include <memory>
 #include <thread>
 #include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <chrono>
+#include <coroutine>
+#include <functional>
+
+#include <keyspace_channel.h>
+#include <write_behind_queue.h>
+#include <change_log.h>
+
+struct redisContext;
+
+/**
+ * @brief Strategy of the subscriber worker when there are no notifications to process.
+ */
+enum class IdleStrategy {
+    /**
+     * @brief Poll the socket without ever sleeping. Lowest latency, one core always busy.
+     */
+    BusySpin,
+
+    /**
+     * @brief Poll the socket, yield and then sleep with exponentially growing interval up to `RedisConfig::max_backoff`.
+     */
+    Backoff,
+
+    /**
+     * @brief Block on socket readiness up to `RedisConfig::blocking_timeout`. Lowest CPU usage.
+     */
+    Blocking
+};
+
+/**
+ * @brief Source of information about values changed in Redis.
+ */
+enum class InvalidationMode {
+    /**
+     * @brief Subscribe to keyspace notifications of registered topics. Needs `CONFIG SET notify-keyspace-events`.
+     */
+    KeyspaceEvents,
+
+    /**
+     * @brief Read changes from a change log in Redis Streams, appended by writers using this library.
+     * 
+     * Changes made while the connection was down are read after it is restored, so only changed values are fetched
+     * again. Writes of clients which do not append to the change log are not noticed.
+     */
+    ChangeLog,
+
+    /**
+     * @brief Use client side caching of Redis 6+ (`CLIENT TRACKING` in `BCAST` mode with a prefix per topic).
+     * 
+     * Server sends invalidations only for keys of registered topics, without enabling keyspace notifications
+     * globally. Own writes are invalidated as well, so values are fetched again after they are written.
+     */
+    Tracking
+};
+
+/**
+ * @brief Configuration of the `RedisHandler`, applied when the handler is created.
+ */
+struct RedisConfig {
+    /**
+     * @brief Host of the Redis server.
+     */
+    std::string host = "127.0.0.1";
+
+    /**
+     * @brief Port of the Redis server.
+     */
+    int port = 6379;
+
+    /**
+     * @brief Index of the Redis database.
+     */
+    int db = 0;
+
+    /**
+     * @brief Strategy of the subscriber worker when there are no notifications to process.
+     */
+    IdleStrategy idle_strategy = IdleStrategy::Blocking;
+
+    /**
+     * @brief Maximum time the worker blocks on the socket in `IdleStrategy::Blocking`, before checking if it should stop.
+     */
+    std::chrono::milliseconds blocking_timeout{100};
+
+    /**
+     * @brief Maximum sleep of the worker in `IdleStrategy::Backoff`.
+     */
+    std::chrono::microseconds max_backoff{1000};
+
+    /**
+     * @brief Delay before the first attempt to reconnect the subscriber, doubled after every failed attempt.
+     */
+    std::chrono::milliseconds reconnect_delay{50};
+
+    /**
+     * @brief Maximum delay between attempts to reconnect the subscriber.
+     */
+    std::chrono::milliseconds max_reconnect_delay{2000};
+
+    /**
+     * @brief Maximum number of notifications applied in one batch.
+     */
+    std::size_t max_batch_size = 1024;
+
+    /**
+     * @brief Source of information about values changed in Redis.
+     */
+    InvalidationMode invalidation_mode = InvalidationMode::KeyspaceEvents;
+
+    /**
+     * @brief Whether writes of scalar values also publish the new value on the channel of their topic.
+     * 
+     * Readers subscribed to the topic replace their local copy with the published value instead of fetching it.
+     * Writers which do not publish, e.g. other clients or atomic increments, are still noticed through invalidations.
+     */
+    bool publish_values = false;
+
+    /**
+     * @brief Approximate maximum number of entries kept in the change log of each topic, in `InvalidationMode::ChangeLog`.
+     */
+    long long change_log_max_length = 10000;
+
+    /**
+     * @brief Maximum time the change log reader blocks waiting for new entries.
+     */
+    std::chrono::milliseconds change_log_block{100};
+
+    /**
+     * @brief Minimal size of encoded scalar values which are stored compressed with LZ4, 0 disables compression.
+     * 
+     * Default of every value, which can be changed by `ScalarCacheValue::setCompressionThreshold`.
+     */
+    std::size_t compression_threshold = 0;
+
+    /**
+     * @brief Whether writes of scalar values are queued and written by a background thread.
+     * 
+     * Repeated writes of the same value between flushes collapse into a single `SET`. Asynchronous writes
+     * of scalar values are completed as soon as they are queued. Use `RedisHandler::flush` to wait for them.
+     */
+    bool write_behind = false;
+
+    /**
+     * @brief Maximum time a write waits in the write-behind queue.
+     */
+    std::chrono::milliseconds write_behind_interval{10};
+
+    /**
+     * @brief Number of queued writes which triggers flush before `write_behind_interval` elapses.
+     */
+    std::size_t write_behind_batch_size = 512;
+
+    /**
+     * @brief Executor resuming coroutines waiting for cache operations, e.g. by posting them to a thread pool.
+     * 
+     * Called on the event loop thread of redis-plus-plus. If empty, coroutines are resumed right on that thread.
+     */
+    std::function<void(std::coroutine_handle<>)> executor;
+};
+
+/**
+ * @brief Snapshot of counters describing processing of keyspace notifications.
+ */
+struct NotificationStats {
+    /**
+     * @brief Total number of notifications received.
+     */
+    std::uint64_t messages = 0;
+
+    /**
+     * @brief Number of batches applied to topics.
+     */
+    std::uint64_t batches = 0;
+
+    /**
+     * @brief Size of the last applied batch.
+     */
+    std::uint64_t last_batch_size = 0;
+
+    /**
+     * @brief Size of the biggest applied batch.
+     */
+    std::uint64_t max_batch_size = 0;
+
+    /**
+     * @brief Number of bytes already read from the socket, but not processed yet, when the last batch was applied.
+     */
+    std::uint64_t backlog_bytes = 0;
+
+    /**
+     * @brief Number of times the subscriber connection was restored after it failed.
+     */
+    std::uint64_t reconnects = 0;
+};
 
 /**
  * @brief A singleton class that manages a connection to a Redis database.
  * 
  * This class encapsulates a connection to a Redis database using the `sw::redis::Redis` class. 
- * It also maintains a subscriber for the Redis publish/subscribe mechanism, and runs a worker 
- * thread that processes incoming messages from subscribed Redis channels and check if value changed, if so add value id to 
- * changed paramaters set in value topic.
+ * It also maintains a subscriber connection for the Redis publish/subscribe mechanism, and runs a worker 
+ * thread that drains incoming keyspace notifications in batches and marks changed values in their topics.
+ * Subscriber connection uses hiredis directly, because worker needs to know when socket is drained.
+ * Notifications are subscribed only for keys of registered topics, and only for event classes needed by
+ * registered value types.
+ * If the subscriber connection fails, the worker reconnects it, restores all subscriptions and marks all values
+ * as changed, because notifications sent in the meantime are lost.
  * The `getInstance` method is used to access the single instance of this class.
  */
 class RedisHandler {
@@ -24,21 +229,121 @@ private:
      */
     static RedisHandler instance_;
 
+    /**
+     * @brief Configuration used when the instance is created.
+     */
+    static RedisConfig config_;
+
+    /**
+     * @brief Flag telling if the instance was already created, so configuration cannot be changed anymore.
+     */
+    static std::atomic<bool> created_;
+
     /**
      * @brief A shared pointer to the Redis object.
      */
     std::shared_ptr<sw::redis::Redis> redis_;
 
     /**
-     * @brief The Redis subscriber object.
+     * @brief A shared pointer to the asynchronous Redis object, used by asynchronous operations of cache values.
+     */
+    std::shared_ptr<sw::redis::AsyncRedis> async_redis_;
+
+    /**
+     * @brief Change log of the topics, if `RedisConfig::invalidation_mode` is `InvalidationMode::ChangeLog`.
+     */
+    std::unique_ptr<ChangeLog> change_log_;
+
+    /**
+     * @brief Queue of scalar writes, if `RedisConfig::write_behind` is enabled.
+     * 
+     * Declared after the connections, so remaining writes are flushed before they are closed.
      */
-    sw::redis::Subscriber sub_;
+    std::unique_ptr<WriteBehindQueue> write_behind_;
+
+    /**
+     * @brief The hiredis context of the subscriber connection.
+     */
+    redisContext* sub_ctx_;
+
+    /**
+     * @brief The hiredis context of the connection which enables `CLIENT TRACKING`, in `InvalidationMode::Tracking`.
+     * 
+     * Tracking redirects invalidations to the subscriber connection. It is enabled on a dedicated connection,
+     * because connections of redis-plus-plus are pooled and silently reconnected, which would drop tracking.
+     */
+    redisContext* tracking_ctx_;
+
+    /**
+     * @brief Client ID of the subscriber connection, target of redirected invalidations.
+     */
+    long long subscriber_id_;
+
+    /**
+     * @brief Key prefixes with enabled tracking.
+     */
+    std::set<std::string> tracking_prefixes_;
+
+    /**
+     * @brief Mutex guarding `tracking_ctx_` and `tracking_prefixes_`.
+     */
+    std::mutex tracking_mutex_;
 
     /**
      * @brief Atomic boolean flag to control the worker thread.
      */
     std::atomic<bool> stop_worker_;
 
+    /**
+     * @brief Event file descriptor used to wake the worker thread up when subscriptions change.
+     */
+    int wake_fd_;
+
+    /**
+     * @brief Mutex guarding subscription requests and confirmations.
+     */
+    std::mutex subscription_mutex_;
+
+    /**
+     * @brief Condition variable notified when Redis confirms a subscription change.
+     */
+    std::condition_variable subscription_cv_;
+
+    /**
+     * @brief Subscription commands waiting to be sent by the worker thread, as pairs of command and pattern.
+     */
+    std::vector<std::pair<std::string, std::string>> pending_subscriptions_;
+
+    /**
+     * @brief Active subscriptions, mapping each pattern or channel to its subscribe command. Restored after reconnecting.
+     */
+    std::map<std::string, std::string> subscriptions_;
+
+    /**
+     * @brief Number of requested subscription changes.
+     */
+    std::uint64_t subscription_requests_;
+
+    /**
+     * @brief Number of subscription changes confirmed by Redis.
+     */
+    std::uint64_t subscription_acks_;
+
+    /**
+     * @brief Flag telling if the worker thread still processes the subscriber connection.
+     */
+    bool worker_running_;
+
+    /**
+     * @brief Number of registered values needing each keyspace event class.
+     */
+    std::map<char, int> event_class_refs_;
+
+    /**
+     * @brief Mutex guarding `event_class_refs_`.
+     */
+    std::mutex event_class_mutex_;
+
     /**
      * @brief The Redis connection options.
      */
@@ -50,10 +355,182 @@ private:
     std::thread worker_thread_;
 
     /**
-     * @brief The worker function that runs in `worker_thread_`. Consuming messages from Redis channels every interval time and check if value changed,
-     * if so add value id to changed paramaters set in value topic.
+     * @brief Notifications collected in current batch.
+     * 
+     * Channels are views into replies kept in `batch_replies_`, so collecting a notification does not allocate.
+     */
+    std::vector<KeyspaceChannel> batch_;
+
+    /**
+     * @brief hiredis replies referenced by `batch_`, freed when the batch is applied.
+     */
+    std::vector<void*> batch_replies_;
+
+    /**
+     * @brief Notifications of one topic group of the batch, reused between batches.
+     */
+    std::vector<KeyspaceChannel> batch_group_;
+
+    /**
+     * @brief Counter of received notifications, see `NotificationStats::messages`.
+     */
+    std::atomic<std::uint64_t> stat_messages_;
+
+    /**
+     * @brief Counter of applied batches, see `NotificationStats::batches`.
+     */
+    std::atomic<std::uint64_t> stat_batches_;
+
+    /**
+     * @brief Size of the last applied batch, see `NotificationStats::last_batch_size`.
+     */
+    std::atomic<std::uint64_t> stat_last_batch_size_;
+
+    /**
+     * @brief Size of the biggest applied batch, see `NotificationStats::max_batch_size`.
+     */
+    std::atomic<std::uint64_t> stat_max_batch_size_;
+
+    /**
+     * @brief Unprocessed bytes when the last batch was applied, see `NotificationStats::backlog_bytes`.
+     */
+    std::atomic<std::uint64_t> stat_backlog_bytes_;
+
+    /**
+     * @brief Number of restored subscriber connections, see `NotificationStats::reconnects`.
+     */
+    std::atomic<std::uint64_t> stat_reconnects_;
+
+    /**
+     * @brief The worker function that runs in `worker_thread_`. Waits for the subscriber socket to become readable
+     * according to the configured `IdleStrategy` and drains all available notifications.
+     */
+    void worker_();
+
+    /**
+     * @brief Wait before next poll of the subscriber socket in `IdleStrategy::Backoff`.
+     * 
+     * @param idle_rounds Number of consecutive polls which found nothing to process.
+     */
+    void backoff_(int idle_rounds);
+
+    /**
+     * @brief Reconnect the failed subscriber connection, retrying with a growing delay until it succeeds or the worker stops.
+     * 
+     * All values are marked as changed afterwards, except in `InvalidationMode::ChangeLog`, whose reader reads missed changes itself.
+     */
+    void reconnectSubscriber_();
+
+    /**
+     * @brief Open a new subscriber connection and restore tracking and all subscriptions on it.
+     * 
+     * Waits until Redis confirms the subscriptions, notifications received meanwhile are collected into the batch.
+     * 
+     * @return `false` if connecting or subscribing failed, `true` otherwise.
      */
-    void worker_(sw::redis::Subscriber&, int, const std::atomic<bool>&);
+    bool connectSubscriber_();
+
+    /**
+     * @brief Read and process all notifications available without blocking.
+     * 
+     * @return `false` if the subscriber connection failed, `true` otherwise.
+     */
+    bool drainNotifications_();
+
+    /**
+     * @brief Add notification from the reply to the current batch, if it is a keyspace notification.
+     * 
+     * Takes ownership of the reply.
+     * 
+     * @param reply The hiredis reply read from the subscriber connection.
+     */
+    void collectNotification_(void* reply);
+
+    /**
+     * @brief Add keys of an invalidation message to the current batch.
+     * 
+     * Takes ownership of the reply. Invalidation without keys, sent when the database is flushed, marks all values as changed.
+     * 
+     * @param reply The hiredis reply of `__redis__:invalidate` message.
+     */
+    void collectInvalidation_(void* reply);
+
+    /**
+     * @brief Add the value of a message published by a writer to the current batch.
+     * 
+     * Takes ownership of the reply. Message has form `<id>:<encoded value>`.
+     * 
+     * @param reply The hiredis reply of the message.
+     */
+    void collectPublished_(void* reply);
+
+    /**
+     * @brief Apply the current batch to the topics, grouped by topic, and clear it.
+     */
+    void applyBatch_();
+
+    /**
+     * @brief Get the keyspace channel pattern matching all keys of the topic.
+     * 
+     * @param topic_path The path of the topic.
+     * @return The pattern with glob characters of topic path escaped.
+     */
+    std::string keyspacePattern_(const std::string& topic_path);
+
+    /**
+     * @brief Queue a subscription command for the worker thread and wait until Redis confirms it.
+     * 
+     * @param command The command, `PSUBSCRIBE`, `PUNSUBSCRIBE`, `SUBSCRIBE` or `UNSUBSCRIBE`.
+     * @param pattern The channel pattern, or the channel.
+     */
+    void requestSubscription_(const std::string& command, const std::string& pattern);
+
+    /**
+     * @brief Send queued subscription commands. Called from the worker thread.
+     * 
+     * @return `false` if the subscriber connection failed, `true` otherwise.
+     */
+    bool sendPendingSubscriptions_();
+
+    /**
+     * @brief Open the tracking connection and subscribe the subscriber connection to `__redis__:invalidate`.
+     * 
+     * Called from the constructor before the worker thread is started, and from the worker thread after reconnecting.
+     * Caller has to hold `tracking_mutex_` once the worker thread runs.
+     */
+    void connectTracking_();
+
+    /**
+     * @brief Send `CLIENT TRACKING` for the prefix on the tracking connection. Caller has to hold `tracking_mutex_`.
+     * 
+     * @param prefix The key prefix.
+     */
+    void enableTracking_(const std::string& prefix);
+
+    /**
+     * @brief Enable tracking of keys with the prefix, unless it is already tracked.
+     * 
+     * @param prefix The key prefix.
+     */
+    void trackPrefix_(const std::string& prefix);
+
+    /**
+     * @brief Add the event classes needed by registered values to `notify-keyspace-events`.
+     * 
+     * Classes already enabled, by this or any other process, are kept, so the flags are never narrowed.
+     * `CONFIG GET` and `CONFIG SET` cannot be made atomic, so processes adding classes at the same time may
+     * overwrite each other's classes. Lost classes are only restored by `verifyKeyspaceEvents_`, notifications
+     * missed until then are not. Does nothing unless `InvalidationMode::KeyspaceEvents` is used.
+     * Caller has to hold `event_class_mutex_` once values are registered.
+     */
+    void updateKeyspaceEvents_();
+
+    /**
+     * @brief Add the event classes needed by registered values again, in case another process overwrote them.
+     * 
+     * Called when a topic is subscribed and after the subscriber reconnects.
+     */
+    void verifyKeyspaceEvents_();
 
     /**
      * @brief Private constructor for the singleton class.
@@ -76,6 +553,15 @@ public:
      */
     RedisHandler& operator=(const RedisHandler&) = delete;
 
+    /**
+     * @brief Set configuration of the `RedisHandler`.
+     * 
+     * Has to be called before the first call of `getInstance`, throws `std::logic_error` otherwise.
+     * 
+     * @param config The configuration.
+     */
+    static void configure(const RedisConfig& config);
+
     /**
      * @brief Get the single instance of the `RedisHandler` class.
      * 
@@ -83,12 +569,120 @@ public:
      */
     static RedisHandler& getInstance();
 
+    /**
+     * @brief Get configuration of the `RedisHandler`.
+     * 
+     * @return The configuration set by `configure`.
+     */
+    static const RedisConfig& getConfig();
+
+    /**
+     * @brief Escape glob characters of a string, so it can be used as a literal part of a Redis pattern.
+     * 
+     * @param value The string to escape.
+     * @return The escaped string.
+     */
+    static std::string escapePattern(const std::string& value);
+
+    /**
+     * @brief Get the channel on which new values of the topic are published, if `RedisConfig::publish_values` is enabled.
+     * 
+     * @param topic_path The path of the topic.
+     * @return The channel.
+     */
+    static std::string publishChannel(const std::string& topic_path);
+
     /**
      * @brief Get the Redis connection object.
      * 
      * @return A pointer to the `sw::redis::Redis` object.
      */
     sw::redis::Redis* getRedis();
+
+    /**
+     * @brief Get the asynchronous Redis connection object.
+     * 
+     * Its replies are delivered on the event loop thread of redis-plus-plus.
+     * 
+     * @return A pointer to the `sw::redis::AsyncRedis` object.
+     */
+    sw::redis::AsyncRedis* getAsyncRedis();
+
+    /**
+     * @brief Get the change log of the topics.
+     * 
+     * @return A pointer to the change log, or `nullptr` if `InvalidationMode::ChangeLog` is not used.
+     */
+    ChangeLog* getChangeLog();
+
+    /**
+     * @brief Resume a coroutine waiting for a cache operation with the configured executor.
+     * 
+     * @param handle Handle of the coroutine.
+     */
+    void resume(std::coroutine_handle<> handle);
+
+    /**
+     * @brief Get the queue of scalar writes.
+     * 
+     * @return A pointer to the `WriteBehindQueue`, or `nullptr` if `RedisConfig::write_behind` is disabled.
+     */
+    WriteBehindQueue* getWriteBehind();
+
+    /**
+     * @brief Write all queued writes to Redis and wait until they are confirmed.
+     * 
+     * Does nothing if `RedisConfig::write_behind` is disabled.
+     */
+    void flush();
+
+    /**
+     * @brief Get counters describing processing of keyspace notifications.
+     * 
+     * @return Snapshot of the counters.
+     */
+    NotificationStats getNotificationStats();
+
+    /**
+     * @brief Subscribe to keyspace notifications of all keys of the topic.
+     * 
+     * Returns after Redis confirms the subscription, so no change made after this call is missed.
+     * In `InvalidationMode::Tracking` enables tracking of the topic key prefix instead, in `InvalidationMode::ChangeLog`
+     * starts reading the change log of the topic. Also subscribes to
+     * values published on the topic channel if `RedisConfig::publish_values` is enabled.
+     * 
+     * @param topic_path The path of the topic.
+     */
+    void subscribeTopic(const std::string& topic_path);
+
+    /**
+     * @brief Unsubscribe from keyspace notifications of the topic.
+     * 
+     * In `InvalidationMode::Tracking` the prefix stays tracked, because removing it needs tracking to be
+     * disabled for all topics. Invalidations of removed topics are ignored.
+     * 
+     * @param topic_path The path of the topic.
+     */
+    void unsubscribeTopic(const std::string& topic_path);
+
+    /**
+     * @brief Register a value needing the keyspace event class.
+     * 
+     * When the first value needing the class is registered, `notify-keyspace-events` is extended.
+     * 
+     * @param event_class The keyspace event class, e.g. `$` for strings or `l` for lists.
+     */
+    void requireEventClass(char event_class);
+
+    /**
+     * @brief Unregister a value needing the keyspace event class.
+     * 
+     * The class stays enabled in `notify-keyspace-events` when the last value needing it is unregistered, because
+     * other processes sharing the Redis may need it as well.
+     * 
+     * @param event_class The keyspace event class.
+     */
+    void releaseEventClass(char event_class);
 };
 
 #endif // REDIS_HANDLER_H
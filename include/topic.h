@@ -3,6 +3,15 @@
 
 #include <set>
 #include <map>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <functional>
+#include <shared_mutex>
+#include <mutex>
+#include <cstdint>
+#include <utility>
+#include <atomic>
 
 #include <topic_manager.h>
 
@@ -11,8 +20,9 @@ class AbstractCacheValue;
 /**
  * @brief A class that represents a topic in the cache.
  * 
- * This class maintains a set of parameters that have changed (`changed_parameters_`), 
- * a map of cache values (`cache_values_`), and the path of the topic (`topic_path_`).
+ * This class maintains a map of cache values (`cache_values_`) and the path of the topic (`topic_path_`).
+ * Changes of the values are tracked by the values themselves, topic only forwards change notifications
+ * from the `RedisHandler` subscriber thread to the right value.
  * Topic path is path where values from this topic are stored in redis. 
  * It provides methods for checking and clearing changed parameters, adding, removing, 
  * and accessing cache values, and checking if a cache value exists. It also provides 
@@ -20,11 +30,6 @@ class AbstractCacheValue;
  */
 class Topic {
 private:
-    /**
-     * @brief A set of parameters that have changed.
-     */
-    std::set<std::string> changed_parameters_;
-
     /**
      * @brief The path of the topic.
      */
@@ -34,8 +39,30 @@ private:
      * @brief A map of cache values.
      * 
      * The keys are the IDs of the cache values and the values are pointers to `AbstractCacheValue` objects.
+     * Transparent comparator allows lookups by `std::string_view` without allocating a key.
+     */
+    std::map <std::string, AbstractCacheValue*, std::less<>> cache_values_;
+
+    /**
+     * @brief Mutex guarding `cache_values_`, which is read by the `RedisHandler` subscriber thread.
      */
-    std::map <std::string, AbstractCacheValue*> cache_values_;
+    mutable std::shared_mutex cache_values_mutex_;
+
+    /**
+     * @brief Invalidation epoch of the topic, bumped when all its values may be stale.
+     * 
+     * Epoch of a value is the sum of this and the global epoch of the `TopicManager`, both only grow.
+     */
+    std::atomic<std::uint64_t> epoch_;
+
+    /**
+     * @brief A value to be fetched, with its version and epoch loaded before fetching.
+     */
+    struct ChangedValue {
+        AbstractCacheValue* cache_value;
+        std::uint64_t version;
+        std::uint64_t epoch;
+    };
 
     /**
      * @brief Construct a new `Topic` object.
@@ -46,8 +73,43 @@ private:
 
     /**
      * @brief Destroy the `Topic` object.
+     * 
+     * Detaches all values still registered in this topic.
+     */
+    ~Topic();
+
+    /**
+     * @brief Remove a cache value from the topic without deleting it.
+     * 
+     * Called by the value when it is destroyed. Does nothing if other value is registered under the same ID.
+     * 
+     * @param cache_value A pointer to the `AbstractCacheValue` object to detach.
+     */
+    void detachCacheValue_(AbstractCacheValue* cache_value);
+
+    /**
+     * @brief Collect values that have changed since their last fetch, together with their current version and epoch.
+     * 
+     * @param changed_values Vector the changed values are appended to.
+     */
+    void collectChanged_(std::vector<ChangedValue>& changed_values);
+
+    /**
+     * @brief Fetch given values in a single pipeline and mark them as fetched in given version.
+     * 
+     * Scalars are fetched with a single `MGET`, containers with their own commands queued in the same pipeline.
+     * Recorded changes of values whose epoch has changed are ignored, because changes may have been missed.
+     * 
+     * @param changed_values The values to fetch, together with their version and epoch loaded before fetching.
+     */
+    static void refreshValues_(const std::vector<ChangedValue>& changed_values);
+
+    /**
+     * @brief Fetch given values in a single pipeline, regardless of their version.
+     * 
+     * @param cache_values The values to fetch.
      */
-    ~Topic() = default;
+    static void loadValues_(const std::vector<AbstractCacheValue*>& cache_values);
 
     /**
      * @brief Give the `TopicManager` class friend access.
@@ -56,6 +118,13 @@ private:
      */
     friend class TopicManager;
 
+    /**
+     * @brief Give the `AbstractCacheValue` class friend access.
+     * 
+     * This allows the value to detach itself from the topic when it is destroyed.
+     */
+    friend class AbstractCacheValue;
+
 public:
     /**
      * @brief Delete the copy constructor.
@@ -70,22 +139,65 @@ public:
     /**
      * @brief Check the parameters that have changed.
      * 
+     * Builds the set by checking version of every value in the topic, so it should not be used in hot paths.
+     * Values check their own version on read.
+     * 
      * @return A set of the parameters that have changed.
      */
     std::set<std::string> check_changed_parameters();
 
     /**
-     * @brief Clear the set of changed parameters.
+     * @brief Mark all values in the topic as up to date.
      */
     void clear_changed_parameters();
 
     /**
-     * @brief Remove a changed parameter.
+     * @brief Mark a changed parameter as up to date.
      * 
      * @param parameter The parameter to remove.
      */
     void removeChangedParameter(std::string parameter);
 
+    /**
+     * @brief Fetch all changed values of the topic from Redis in a single round trip.
+     * 
+     * Has to be called from the thread reading the values, like reads of the values themselves.
+     * Cheaper than reading changed values one by one, which costs a round trip per value.
+     */
+    void refresh();
+
+    /**
+     * @brief Mark a parameter as changed in Redis.
+     * 
+     * Called from the `RedisHandler` subscriber thread. Does nothing if there is no value with given ID.
+     * 
+     * @param parameter The parameter that has changed.
+     */
+    void markChanged(std::string parameter);
+
+    /**
+     * @brief Mark a batch of parameters as changed in Redis.
+     * 
+     * Called from the `RedisHandler` subscriber thread. Takes the lock once for the whole batch.
+     * 
+     * @param changes Notifications of the changed parameters, with their events.
+     */
+    void markChanged(const std::vector<KeyspaceChannel>& changes);
+
+    /**
+     * @brief Mark all values of the topic as changed in Redis, by bumping the epoch of the topic.
+     * 
+     * Called from a background thread. Values are fetched whole on their next read or `refresh`.
+     */
+    void markAllChanged();
+
+    /**
+     * @brief Get the epoch of values of the topic, the sum of the global and the topic epoch.
+     * 
+     * @return The epoch.
+     */
+    std::uint64_t getEpoch() const;
+
     /**
      * @brief Get the path of the topic.
      * 
@@ -103,6 +215,8 @@ public:
     /**
      * @brief Remove a cache value from the topic.
      * 
+     * Destroys the value and deletes its key, together with its change log entry in `InvalidationMode::ChangeLog`.
+     * 
      * @param id The ID of the cache value to remove.
      */
     void removeCacheValue(std::string id);
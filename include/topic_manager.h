@@ -3,8 +3,19 @@
 
 #include <map>
 #include <string>
+#include <vector>
+#include <string_view>
+#include <functional>
+#include <shared_mutex>
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+
+#include <keyspace_channel.h>
 
 class Topic;
+class AbstractCacheValue;
 
 /**
  * @brief A singleton class that manages a collection of `Topic` objects.
@@ -28,12 +39,26 @@ private:
     /**
      * @brief Private constructor for the singleton class.
      */
-    TopicManager() = default;
+    TopicManager() : epoch_(0) {}
 
     /**
      * @brief A map of topic names to `Topic` pointers.
+     * 
+     * Transparent comparator allows lookups by `std::string_view` without allocating a key.
+     */
+    std::map<std::string, Topic*, std::less<>> topics_;
+
+    /**
+     * @brief Mutex guarding `topics_`, which is read by the `RedisHandler` subscriber thread.
      */
-    std::map<std::string, Topic*> topics_;
+    mutable std::shared_mutex topics_mutex_;
+
+    /**
+     * @brief Global invalidation epoch, bumped when all values of all topics may be stale.
+     * 
+     * Values remember the epoch of their last fetch, so invalidating everything is a single increment.
+     */
+    std::atomic<std::uint64_t> epoch_;
 
     /**
      * @brief The single instance of this class.
@@ -59,13 +84,31 @@ public:
     /**
      * @brief Create a new `Topic` object.
      * 
+     * Subscribes to keyspace notifications of the topic keys. Does nothing if the topic already exists.
+     * 
      * @param name The name of the new topic.
      */
     void createTopic(std::string name);
 
+    /**
+     * @brief Create cache values of all keys of a topic already stored in Redis, without writing anything back.
+     * 
+     * Creates the topic if it does not exist. Keys are found with `SCAN`, their types are fetched in a pipeline
+     * per page and all values are loaded in a single pipeline. Redis strings become `CacheString`, because
+     * their encoding does not tell which type wrote them. Keys with unsupported types, keys nested deeper
+     * than the topic and IDs already registered in the topic are skipped.
+     * 
+     * @param name The name of the topic.
+     * @return The created values, which stay registered in the topic until they are destroyed.
+     */
+    std::vector<std::unique_ptr<AbstractCacheValue>> hydrateTopic(std::string name);
+
     /**
      * @brief Remove a `Topic` object.
      * 
+     * Unsubscribes from keyspace notifications of the topic keys and deletes the key named after the topic.
+     * In `InvalidationMode::ChangeLog`, deletion of that key is logged if it is a value of a parent topic.
+     * 
      * @param name The name of the topic to remove.
      */
     void removeTopic(std::string name);
@@ -87,13 +130,56 @@ public:
      */
     bool exists(std::string name);
 
+    /**
+     * @brief Fetch changed values of all topics from Redis in a single round trip.
+     * 
+     * Has to be called from the thread reading the values, like reads of the values themselves.
+     */
+    void refresh();
+
     /**
      * @brief Add a changed parameter to a `Topic` object.
      * 
+     * Called from the `RedisHandler` subscriber thread. Bumps the version of the changed value.
+     * 
      * @param topic The name of the topic.
      * @param parameter The parameter that has changed.
      */
     void addChangedParameter(std::string topic, std::string parameter);
+
+    /**
+     * @brief Add a batch of changed parameters to a `Topic` object.
+     * 
+     * Called from the `RedisHandler` subscriber thread. Looks the topic up once for the whole batch.
+     * 
+     * @param topic The name of the topic.
+     * @param changes Notifications of the changed parameters, with their events.
+     */
+    void addChangedParameters(std::string_view topic, const std::vector<KeyspaceChannel>& changes);
+
+    /**
+     * @brief Get the global invalidation epoch.
+     * 
+     * @return The epoch.
+     */
+    std::uint64_t getEpoch() const;
+
+    /**
+     * @brief Mark all values of all topics as changed, by bumping the global epoch.
+     * 
+     * Called from the `RedisHandler` subscriber thread, when Redis invalidates all keys at once or notifications were lost.
+     * Values are fetched whole on their next read or `refresh`.
+     */
+    void markAllChanged();
+
+    /**
+     * @brief Mark all values of a topic as changed.
+     * 
+     * Called from a background thread, when changes of the topic may have been missed.
+     * 
+     * @param topic The name of the topic.
+     */
+    void markAllChanged(std::string_view topic);
 };
 
 #endif // TOPIC_MANAGER_H
\ No newline at end of file
@@ -0,0 +1,174 @@
+#ifndef VALUE_CODEC_H
+#define VALUE_CODEC_H
+
+#include <algorithm>
+#include <bit>
+#include <concepts>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+/**
+ * @brief Requirements of a codec converting values of type `T` to and from their representation in Redis.
+ * 
+ * Codec is a type with static `encode` and `decode` functions, selected at compile time by `CacheValue`.
+ * 
+ * @tparam Codec The codec.
+ * @tparam T Type of the values.
+ */
+template <typename Codec, typename T>
+concept ValueCodec = requires(const T& value, const std::string& encoded) {
+    { Codec::encode(value) } -> std::convertible_to<std::string>;
+    { Codec::decode(encoded) } -> std::convertible_to<T>;
+};
+
+/**
+ * @brief Codec used by `CacheValue` when no other codec is given. Specialized for supported types.
+ * 
+ * @tparam T Type of the values.
+ */
+template <typename T>
+struct DefaultCodec;
+
+/**
+ * @brief Codecs whose encoded values can be modified on the server with `INCRBY` or `INCRBYFLOAT`.
+ * 
+ * @tparam Codec The codec.
+ * @tparam T Type of the values.
+ */
+template <typename Codec, typename T>
+concept ServerArithmeticCodec = std::is_arithmetic_v<T> && std::same_as<Codec, DefaultCodec<T>>;
+
+/**
+ * @brief Codecs whose encoded values can be modified on the server with `APPEND` or `SETRANGE`.
+ * 
+ * @tparam Codec The codec.
+ * @tparam T Type of the values.
+ */
+template <typename Codec, typename T>
+concept StringRangeCodec = std::same_as<T, std::string> && std::same_as<Codec, DefaultCodec<T>>;
+
+/**
+ * @brief Codec storing strings as raw bytes.
+ */
+template <>
+struct DefaultCodec<std::string> {
+    /**
+     * @brief Encode the string, which is the string itself.
+     * 
+     * @param value The string.
+     * @return The encoded value.
+     */
+    static const std::string& encode(const std::string& value){
+        return value;
+    }
+
+    /**
+     * @brief Decode the string, which is the encoded value itself.
+     * 
+     * @param encoded The encoded value.
+     * @return The string.
+     */
+    static const std::string& decode(const std::string& encoded){
+        return encoded;
+    }
+};
+
+/**
+ * @brief Codec storing integers as decimal text, so they can be modified with `INCRBY`.
+ */
+template <>
+struct DefaultCodec<int> {
+    /**
+     * @brief Encode the integer as decimal text with `std::to_chars`.
+     * 
+     * @param value The integer.
+     * @return The encoded value.
+     */
+    static std::string encode(int value);
+
+    /**
+     * @brief Decode the integer from decimal text with `std::from_chars`.
+     * 
+     * @param encoded The encoded value.
+     * @return The integer.
+     * @throws std::invalid_argument If the encoded value is not a whole integer.
+     */
+    static int decode(const std::string& encoded);
+};
+
+/**
+ * @brief Codec storing floats as decimal text, so they can be modified with `INCRBYFLOAT`.
+ * 
+ * Shortest text which reads back as the same float is used, so values are not rounded and e.g. `0.1f` is stored as `0.1`.
+ */
+template <>
+struct DefaultCodec<float> {
+    /**
+     * @brief Encode the float as the shortest round-trip decimal text with `std::to_chars`.
+     * 
+     * @param value The float.
+     * @return The encoded value.
+     */
+    static std::string encode(float value);
+
+    /**
+     * @brief Decode the float from decimal text with `std::from_chars`, independently of the locale.
+     * 
+     * @param encoded The encoded value.
+     * @return The float.
+     * @throws std::invalid_argument If the encoded value is not a whole number.
+     */
+    static float decode(const std::string& encoded);
+};
+
+/**
+ * @brief Codec storing arithmetic values as their little-endian bytes.
+ * 
+ * Encoding is a copy of a few bytes and lossless, but the values are not readable by other clients and cannot be
+ * modified with `INCRBY` or `INCRBYFLOAT`. Meant for processes which only share the values among themselves.
+ * 
+ * @tparam T Type of the values.
+ */
+template <typename T>
+requires std::is_arithmetic_v<T>
+struct BinaryCodec {
+    /**
+     * @brief Encode the value as its little-endian bytes.
+     * 
+     * @param value The value.
+     * @return The encoded value.
+     */
+    static std::string encode(T value){
+        std::string encoded(sizeof(T), '\0');
+        std::memcpy(encoded.data(), &value, sizeof(T));
+        if constexpr (std::endian::native == std::endian::big)
+            std::reverse(encoded.begin(), encoded.end());
+        return encoded;
+    }
+
+    /**
+     * @brief Decode the value from its little-endian bytes.
+     * 
+     * @param encoded The encoded value.
+     * @return The value.
+     * @throws std::invalid_argument If the encoded value does not have the size of `T`.
+     */
+    static T decode(const std::string& encoded){
+        if (encoded.size() != sizeof(T))
+            throw std::invalid_argument("Binary value has " + std::to_string(encoded.size()) + " bytes instead of " + std::to_string(sizeof(T)));
+        T value;
+        if constexpr (std::endian::native == std::endian::big) {
+            char bytes[sizeof(T)];
+            std::reverse_copy(encoded.begin(), encoded.end(), bytes);
+            std::memcpy(&value, bytes, sizeof(T));
+        }
+        else {
+            std::memcpy(&value, encoded.data(), sizeof(T));
+        }
+        return value;
+    }
+};
+
+#endif // VALUE_CODEC_H
@@ -0,0 +1,180 @@
+#ifndef WRITE_BATCH_H
+#define WRITE_BATCH_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <functional>
+#include <type_traits>
+
+#include <value_codec.h>
+
+class AbstractCacheValue;
+class ScalarCacheValue;
+template <typename T, typename Codec>
+requires ValueCodec<Codec, T>
+class CacheValue;
+class CacheList;
+class CacheMap;
+class CacheSet;
+
+/**
+ * @brief A batch of writes of cache values, committed to Redis in a single round trip.
+ * 
+ * Writes are collected from any values, possibly in different topics, and sent in a single pipeline, or in
+ * a `MULTI`/`EXEC` transaction if the batch is atomic. Local copies of the values are updated once the batch
+ * is committed, values whose write failed are marked as changed instead. Values have to outlive the commit.
+ */
+class WriteBatch {
+private:
+    /**
+     * @brief A single write of the batch.
+     */
+    struct Operation {
+        /**
+         * @brief The written value.
+         */
+        AbstractCacheValue* value;
+
+        /**
+         * @brief The Redis command with its arguments.
+         */
+        std::vector<std::string> command;
+
+        /**
+         * @brief Number of echoes of the command which should be suppressed, 0 unless its notifications do not
+         * depend on the state of the key.
+         */
+        std::uint32_t echoes;
+
+        /**
+         * @brief Update of the local copy, applied once the command succeeds.
+         */
+        std::function<void()> apply;
+    };
+
+    /**
+     * @brief Whether the batch is committed as a `MULTI`/`EXEC` transaction.
+     */
+    bool atomic_;
+
+    /**
+     * @brief Collected writes.
+     */
+    std::vector<Operation> operations_;
+
+    /**
+     * @brief Add a write to the batch.
+     * 
+     * @param value The written value.
+     * @param command The Redis command with its arguments, the key of the value is inserted after the command name.
+     * @param echoes Number of echoes of the command which should be suppressed.
+     * @param apply Update of the local copy.
+     */
+    void add_(AbstractCacheValue& value, std::vector<std::string> command, std::uint32_t echoes, std::function<void()> apply);
+
+    /**
+     * @brief Add a write of a scalar value to the batch, with the same command as the value uses itself.
+     * 
+     * @param value The written value.
+     * @param encoded The new encoded value.
+     * @param apply Update of the local copy.
+     */
+    void addScalar_(ScalarCacheValue& value, const std::string& encoded, std::function<void()> apply);
+
+    /**
+     * @brief Send all writes through a pipeline or transaction and apply their results.
+     * 
+     * @param queued Pipeline or transaction to send writes through.
+     */
+    template <typename Queued>
+    void commit_(Queued& queued);
+
+public:
+    /**
+     * @brief Construct a new `WriteBatch` object.
+     * 
+     * @param atomic Whether the batch is committed as a `MULTI`/`EXEC` transaction.
+     */
+    explicit WriteBatch(bool atomic = false);
+
+    /**
+     * @brief Set the value of a scalar cache value.
+     * 
+     * @param value The cache value.
+     * @param new_value The new value.
+     */
+    template <typename T, typename Codec>
+    void setValue(CacheValue<T, Codec>& value, std::type_identity_t<T> new_value){
+        std::string encoded = Codec::encode(new_value);
+        addScalar_(value, encoded, [&value, new_value = std::move(new_value)](){
+            value.value_ = new_value;
+        });
+    }
+
+    /**
+     * @brief Add a string to the end of the list.
+     * 
+     * @param value The cache value.
+     * @param element The string to add.
+     */
+    void rpush(CacheList& value, std::string element);
+
+    /**
+     * @brief Add a string to the front of the list.
+     * 
+     * @param value The cache value.
+     * @param element The string to add.
+     */
+    void lpush(CacheList& value, std::string element);
+
+    /**
+     * @brief Add a key-value pair to the map.
+     * 
+     * @param value The cache value.
+     * @param key The key to add.
+     * @param val The value to add.
+     */
+    void addKey(CacheMap& value, std::string key, std::string val);
+
+    /**
+     * @brief Erase a key-value pair from the map.
+     * 
+     * @param value The cache value.
+     * @param key The key to erase.
+     */
+    void eraseKey(CacheMap& value, std::string key);
+
+    /**
+     * @brief Add a string to the set.
+     * 
+     * @param value The cache value.
+     * @param val The string to add.
+     */
+    void addValue(CacheSet& value, std::string val);
+
+    /**
+     * @brief Remove a string from the set.
+     * 
+     * @param value The cache value.
+     * @param val The string to remove.
+     */
+    void removeValue(CacheSet& value, std::string val);
+
+    /**
+     * @brief Check if the batch has no writes.
+     * 
+     * @return `true` if the batch is empty, `false` otherwise.
+     */
+    bool empty() const;
+
+    /**
+     * @brief Send all writes to Redis in a single round trip and update local copies of written values.
+     * 
+     * The batch is empty afterwards. Throws if the batch could not be sent, then no local copy is updated.
+     * Writes rejected by Redis do not throw, their values are marked as changed and fetched again on next read.
+     */
+    void commit();
+};
+
+#endif // WRITE_BATCH_H
@@ -0,0 +1,140 @@
+#ifndef WRITE_BEHIND_QUEUE_H
+#define WRITE_BEHIND_QUEUE_H
+
+#include <sw/redis++/redis++.h>
+#include <unordered_map>
+#include <string>
+#include <utility>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+class ScalarCacheValue;
+class ChangeLog;
+
+/**
+ * @brief A queue coalescing writes of scalar values, which are written to Redis by a background thread.
+ * 
+ * Only the latest write of each value is kept, so repeated writes of the same value between flushes collapse
+ * into a single `SET`. Pending writes are flushed in a single pipeline every interval, or sooner when there
+ * are too many of them. Values with pending write keep their local copy instead of fetching it from Redis,
+ * because the pending write overwrites Redis anyway.
+ */
+class WriteBehindQueue {
+private:
+    /**
+     * @brief Redis connection used for flushing.
+     */
+    sw::redis::Redis* redis_;
+
+    /**
+     * @brief Change log the flushed writes are appended to, `nullptr` if it is not used.
+     */
+    ChangeLog* change_log_;
+
+    /**
+     * @brief Maximum time a write waits in the queue.
+     */
+    std::chrono::milliseconds interval_;
+
+    /**
+     * @brief Number of pending writes which triggers flush before the interval elapses.
+     */
+    std::size_t max_batch_size_;
+
+    /**
+     * @brief Pending writes, mapping each value to the command writing its latest encoded value.
+     */
+    std::unordered_map<ScalarCacheValue*, std::vector<std::string>> pending_;
+
+    /**
+     * @brief Mutex guarding `pending_` and `stop_`.
+     */
+    std::mutex mutex_;
+
+    /**
+     * @brief Condition variable waking the background thread up.
+     */
+    std::condition_variable cv_;
+
+    /**
+     * @brief Mutex held for whole flush, so `flush` waits for the flush in progress.
+     */
+    std::mutex flush_mutex_;
+
+    /**
+     * @brief Whether the background thread should stop.
+     */
+    bool stop_;
+
+    /**
+     * @brief Background thread flushing the pending writes.
+     */
+    std::thread thread_;
+
+    /**
+     * @brief Loop of the background thread.
+     */
+    void worker_();
+
+    /**
+     * @brief Write all pending writes to Redis in a single pipeline.
+     * 
+     * If the pipeline fails, written values are marked as changed, so they are fetched again from Redis.
+     */
+    void flushPending_();
+
+public:
+    /**
+     * @brief Construct a new `WriteBehindQueue` object and start its background thread.
+     * 
+     * @param redis Redis connection used for flushing.
+     * @param change_log Change log the flushed writes are appended to, `nullptr` if it is not used.
+     * @param interval Maximum time a write waits in the queue.
+     * @param max_batch_size Number of pending writes which triggers flush before the interval elapses.
+     */
+    WriteBehindQueue(sw::redis::Redis* redis, ChangeLog* change_log, std::chrono::milliseconds interval, std::size_t max_batch_size);
+
+    /**
+     * @brief Stop the background thread and flush remaining writes.
+     */
+    ~WriteBehindQueue();
+
+    /**
+     * @brief Delete the copy constructor.
+     */
+    WriteBehindQueue(const WriteBehindQueue&) = delete;
+
+    /**
+     * @brief Delete the copy assignment operator.
+     */
+    WriteBehindQueue& operator=(const WriteBehindQueue&) = delete;
+
+    /**
+     * @brief Queue a write of a value, replacing its pending write if there is one.
+     * 
+     * @param value The written value.
+     * @param command The command writing the encoded value, see `ScalarCacheValue::writeCommand_`.
+     */
+    void enqueue(ScalarCacheValue* value, std::vector<std::string> command);
+
+    /**
+     * @brief Drop the pending write of a value, if it has one, e.g. because its key is removed.
+     * 
+     * Waits for the flush in progress, so the value is not written after this returns.
+     * 
+     * @param value The value.
+     */
+    void discard(ScalarCacheValue* value);
+
+    /**
+     * @brief Write all pending writes to Redis and wait until they are confirmed.
+     * 
+     * Throws if the writes fail.
+     */
+    void flush();
+};
+
+#endif // WRITE_BEHIND_QUEUE_H
@@ -1,11 +1,21 @@
 #include <cache_value.h>
 #include <topic_manager.h>
 #include <topic.h>
+#include <change_log.h>
 #include <iostream>
+#include <algorithm>
+#include <iterator>
+#include <vector>
 
-AbstractCacheValue::AbstractCacheValue(std::string id, std::string topic_path){
+AbstractCacheValue::AbstractCacheValue(std::string id, std::string topic_path) : version_(0), fetched_version_(0), pending_echoes_(0), keyspace_event_class_(0), pending_event_(KeyEvent::None), echo_consumed_(false){
     id_ = id;
     topic_ = TopicManager::getInstance().getTopic(topic_path);
+    fetched_epoch_ = topic_ != nullptr ? topic_->getEpoch() : 0;
+}
+
+AbstractCacheValue::~AbstractCacheValue(){
+    if (topic_ != nullptr)
+        topic_->detachCacheValue_(this);
 }
 
 std::string AbstractCacheValue::getId(){
@@ -24,6 +34,202 @@ void AbstractCacheValue::changeTopic(std::string new_topic_path){
     addValueToRedis_();
 }
 
+void AbstractCacheValue::markChanged(std::string_view event){
+    if (consumeEcho_()) {
+        std::lock_guard lock(event_mutex_);
+        echo_consumed_ = true;
+        return;
+    }
+    {
+        // Event is recorded before the version is bumped, so the reader seeing the new version also sees the event.
+        std::lock_guard lock(event_mutex_);
+        pending_event_ = combineEvents_(pending_event_, parseEvent_(event));
+    }
+    version_.fetch_add(1, std::memory_order_release);
+}
+
+void AbstractCacheValue::markPublished(std::string_view encoded){
+    if (consumeEcho_()) {
+        std::lock_guard lock(event_mutex_);
+        echo_consumed_ = true;
+        return;
+    }
+    {
+        std::lock_guard lock(event_mutex_);
+        pending_event_ = KeyEvent::Published;
+        published_value_.assign(encoded);
+    }
+    version_.fetch_add(1, std::memory_order_release);
+}
+
+KeyEvent AbstractCacheValue::parseEvent_(std::string_view event){
+    if (event == "del" || event == "expired" || event == "evicted")
+        return KeyEvent::Deleted;
+    if (event == "rpush" || event == "append")
+        return KeyEvent::Appended;
+    if (event == "lpush")
+        return KeyEvent::Prepended;
+    if (event == "rpop")
+        return KeyEvent::PoppedTail;
+    if (event == "lpop")
+        return KeyEvent::PoppedHead;
+    return KeyEvent::Changed;
+}
+
+KeyEvent AbstractCacheValue::combineEvents_(KeyEvent pending, KeyEvent next){
+    if (next == KeyEvent::Deleted || next == KeyEvent::Published || pending == KeyEvent::None || pending == next)
+        return next;
+    return KeyEvent::Changed;
+}
+
+KeyEvent AbstractCacheValue::takeEvent_(){
+    std::lock_guard lock(event_mutex_);
+    KeyEvent event = pending_event_;
+    pending_event_ = KeyEvent::None;
+    echo_consumed_ = false;
+    return event;
+}
+
+KeyEvent AbstractCacheValue::takeEvent_(std::string& published_value){
+    std::lock_guard lock(event_mutex_);
+    KeyEvent event = pending_event_;
+    pending_event_ = KeyEvent::None;
+    // Echo counter takes whichever notification comes first, so the consumed one may have been a foreign change,
+    // e.g. LSET racing own RPUSH, with the own echo recorded instead. Only a full fetch is then known to be correct.
+    if (echo_consumed_ && event != KeyEvent::None && event != KeyEvent::Deleted && event != KeyEvent::Published)
+        event = KeyEvent::Changed;
+    echo_consumed_ = false;
+    if (event == KeyEvent::Published)
+        published_value.swap(published_value_);
+    return event;
+}
+
+bool AbstractCacheValue::fetchDelta_(KeyEvent){
+    return false;
+}
+
+void AbstractCacheValue::applyPublished_(const std::string&){
+    fetchValue_();
+}
+
+void AbstractCacheValue::expectEcho_(){
+    if (RedisHandler::getConfig().invalidation_mode == InvalidationMode::Tracking)
+        return;
+    pending_echoes_.fetch_add(1, std::memory_order_acq_rel);
+}
+
+std::uint32_t AbstractCacheValue::echoesOf_(std::uint32_t notifications){
+    if (RedisHandler::getConfig().invalidation_mode == InvalidationMode::ChangeLog)
+        return notifications > 0 ? 1 : 0;
+    return notifications;
+}
+
+void AbstractCacheValue::cancelEcho_(){
+    consumeEcho_();
+}
+
+bool AbstractCacheValue::consumeEcho_(){
+    std::uint32_t pending = pending_echoes_.load(std::memory_order_acquire);
+    while (pending > 0) {
+        if (pending_echoes_.compare_exchange_weak(pending, pending - 1, std::memory_order_acq_rel))
+            return true;
+    }
+    return false;
+}
+
+std::uint64_t AbstractCacheValue::epoch_() const{
+    // Value detached from its destroyed topic receives no notifications, so it is never invalidated either.
+    if (topic_ == nullptr)
+        return fetched_epoch_;
+    return topic_->getEpoch();
+}
+
+void AbstractCacheValue::markFetched(){
+    fetched_epoch_ = epoch_();
+    fetched_version_ = version_.load(std::memory_order_acquire);
+}
+
+bool AbstractCacheValue::isChanged(){
+    return version_.load(std::memory_order_acquire) != fetched_version_ || epoch_() != fetched_epoch_;
+}
+
+void AbstractCacheValue::syncValue_(){
+    std::uint64_t epoch = epoch_();
+    std::uint64_t version = version_.load(std::memory_order_acquire);
+    if (version == fetched_version_ && epoch == fetched_epoch_)
+        return;
+
+    std::string published_value;
+    KeyEvent event = takeEvent_(published_value);
+    // Changes may have been missed since the epoch changed, so the recorded one does not describe the whole difference.
+    if (epoch != fetched_epoch_)
+        fetchValue_();
+    else if (event == KeyEvent::Deleted)
+        clearValue_();
+    else if (event == KeyEvent::Published)
+        applyPublished_(published_value);
+    else if (!fetchDelta_(event))
+        fetchValue_();
+    fetched_version_ = version;
+    fetched_epoch_ = epoch;
+}
+
+std::future<std::any> AbstractCacheValue::getValueAsync(){
+    std::uint64_t epoch = epoch_();
+    std::uint64_t version = version_.load(std::memory_order_acquire);
+    if (version == fetched_version_ && epoch == fetched_epoch_) {
+        std::promise<std::any> value;
+        value.set_value(getValue());
+        return value.get_future();
+    }
+    auto reply = std::make_shared<std::promise<std::function<void()>>>();
+    std::future<std::function<void()>> apply = reply->get_future();
+    // Value is fetched whole, so the recorded event is not needed anymore.
+    takeEvent_();
+    fetchValueAsync_([reply](std::function<void()> apply){
+        reply->set_value(std::move(apply));
+    });
+    // Reply is applied by the thread waiting for the future, because local copy is owned by the reading thread.
+    return std::async(std::launch::deferred, [this, version, epoch, apply = std::move(apply)]() mutable {
+        apply.get()();
+        fetched_version_ = version;
+        fetched_epoch_ = epoch;
+        return getValue();
+    });
+}
+
+CacheAwaitable<std::any> AbstractCacheValue::fetchAwait(){
+    std::uint64_t epoch = epoch_();
+    std::uint64_t version = version_.load(std::memory_order_acquire);
+    auto apply = std::make_shared<std::function<void()>>();
+    return CacheAwaitable<std::any>(version == fetched_version_ && epoch == fetched_epoch_, [this, apply](AsyncDone done){
+        takeEvent_();
+        fetchValueAsync_([apply, done](std::function<void()> reply){
+            *apply = std::move(reply);
+            done(nullptr);
+        });
+    }, [this, version, epoch, apply](){
+        if (*apply) {
+            (*apply)();
+            fetched_version_ = version;
+            fetched_epoch_ = epoch;
+        }
+        return getValue();
+    });
+}
+
+void AbstractCacheValue::markStale_(){
+    fetched_version_ = version_.load(std::memory_order_acquire) - 1;
+}
+
+void AbstractCacheValue::forceFetch_(){
+    {
+        std::lock_guard lock(event_mutex_);
+        pending_event_ = KeyEvent::Changed;
+    }
+    markStale_();
+}
+
 std::string AbstractCacheValue::toString(){
     return std::any_cast<std::string>(getValue());
 }
@@ -48,96 +254,152 @@ std::set<std::string> AbstractCacheValue::toSet(){
     return std::any_cast<std::set<std::string>>(getValue());
 }
 
+std::string AbstractCacheValue::redisKey_() const{
+    return topic_->getTopicPath() + ":" + id_;
+}
+
 void AbstractCacheValue::removeValueFromRedis_(){
     RedisHandler::getInstance().getRedis()->del(topic_->getTopicPath() + ":" + id_);
+    logChange_();
 }
 
-CacheString::CacheString(std::string id, std::string topic_path) : AbstractCacheValue(id, topic_path){
-    value_ = "";
-    TopicManager::getInstance().getTopic(topic_path)->addCacheValue(this);
-    addValueToRedis_();
+void AbstractCacheValue::logChange_(){
+    if (ChangeLog* change_log = RedisHandler::getInstance().getChangeLog())
+        change_log->append(topic_->getTopicPath(), id_);
 }
 
-CacheString::CacheString(std::string id, std::string topic_path, std::string value) : AbstractCacheValue(id, topic_path){
-    value_ = value;
-    TopicManager::getInstance().getTopic(topic_path)->addCacheValue(this);
-    addValueToRedis_();
+void AbstractCacheValue::logChange_(sw::redis::Pipeline& pipeline){
+    if (ChangeLog* change_log = RedisHandler::getInstance().getChangeLog())
+        change_log->queueAppend(pipeline, topic_->getTopicPath(), id_);
 }
 
-std::any CacheString::getValue() {
-    if (topic_->check_changed_parameters().contains(id_)) {
-        value_ = *RedisHandler::getInstance().getRedis()->get(topic_->getTopicPath() + ":" + id_);
-        topic_->removeChangedParameter(id_);
-    }
-    return value_;
+void AbstractCacheValue::logChange_(sw::redis::Transaction& transaction){
+    if (ChangeLog* change_log = RedisHandler::getInstance().getChangeLog())
+        change_log->queueAppend(transaction, topic_->getTopicPath(), id_);
 }
 
-void CacheString::setValue(std::string value){
-    value_ = value;
-    addValueToRedis_();
+void AbstractCacheValue::logChangeAsync_(){
+    if (ChangeLog* change_log = RedisHandler::getInstance().getChangeLog())
+        change_log->appendAsync(*RedisHandler::getInstance().getAsyncRedis(), topic_->getTopicPath(), id_);
 }
 
-void CacheString::addValueToRedis_(){
-    RedisHandler::getInstance().getRedis()->set(topic_->getTopicPath() + ":" + id_, value_);
+ScalarCacheValue::ScalarCacheValue(std::string id, std::string topic_path) : AbstractCacheValue(id, topic_path), write_pending_(false), compression_(RedisHandler::getConfig().compression_threshold), stored_packed_(false){}
+
+ScalarCacheValue::~ScalarCacheValue(){
+    if (write_pending_.load(std::memory_order_acquire)) {
+        try {
+            RedisHandler::getInstance().flush();
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Write-behind flush failed: " << e.what() << std::endl;
+        }
+    }
 }
 
+void ScalarCacheValue::registerInTopic_(){
+    topic_->addCacheValue(this);
+}
 
-CacheInt::CacheInt(std::string id, std::string topic_path) : AbstractCacheValue(id, topic_path){
-    value_ = 0;
-    TopicManager::getInstance().getTopic(topic_path)->addCacheValue(this);
-    addValueToRedis_();
+void ScalarCacheValue::discardPendingWrite_(){
+    if (!write_pending_.load(std::memory_order_acquire))
+        return;
+    if (WriteBehindQueue* write_behind = RedisHandler::getInstance().getWriteBehind())
+        write_behind->discard(this);
 }
 
-CacheInt::CacheInt(std::string id, std::string topic_path, int value) : AbstractCacheValue(id, topic_path){
-    value_ = value;
-    TopicManager::getInstance().getTopic(topic_path)->addCacheValue(this);
-    addValueToRedis_();
+void ScalarCacheValue::removeValueFromRedis_(){
+    discardPendingWrite_();
+    AbstractCacheValue::removeValueFromRedis_();
 }
 
-std::any CacheInt::getValue() {
-    if (topic_->check_changed_parameters().contains(id_)) {
-        value_ = std::stoi(*RedisHandler::getInstance().getRedis()->get(topic_->getTopicPath() + ":" + id_));
-        topic_->removeChangedParameter(id_);
-    }
-    return value_;
+void ScalarCacheValue::applyEncoded_(const std::string& encoded){
+    // Pending write overwrites Redis anyway, so local copy is already the latest value.
+    if (write_pending_.load(std::memory_order_acquire))
+        return;
+    stored_packed_ = Compression::isPacked(encoded);
+    if (stored_packed_)
+        decodeValue_(compression_.unpack(encoded));
+    else
+        decodeValue_(encoded);
 }
 
-void CacheInt::setValue(int value){
-    value_ = value;
-    addValueToRedis_();
+void ScalarCacheValue::setCompressionThreshold(std::size_t threshold){
+    compression_.setThreshold(threshold);
 }
 
-void CacheInt::addValueToRedis_(){
-    RedisHandler::getInstance().getRedis()->set(topic_->getTopicPath() + ":" + id_, std::to_string(value_));
+CompressionStats ScalarCacheValue::getCompressionStats() const{
+    return compression_.getStats();
 }
 
-CacheFloat::CacheFloat(std::string id, std::string topic_path) : AbstractCacheValue(id, topic_path){
-    value_ = 0.0f;
-    TopicManager::getInstance().getTopic(topic_path)->addCacheValue(this);
-    addValueToRedis_();
+void ScalarCacheValue::applyPublished_(const std::string& encoded){
+    applyEncoded_(encoded);
 }
 
-CacheFloat::CacheFloat(std::string id, std::string topic_path, float value) : AbstractCacheValue(id, topic_path){
-    value_ = value;
-    TopicManager::getInstance().getTopic(topic_path)->addCacheValue(this);
-    addValueToRedis_();
+std::vector<std::string> ScalarCacheValue::writeCommand_(const std::string& encoded){
+    std::string key = redisKey_();
+    std::string stored = compression_.pack(encoded);
+    stored_packed_ = Compression::isPacked(stored);
+    if (!RedisHandler::getConfig().publish_values)
+        return {"SET", key, stored};
+    // SET goes first, so readers get the keyspace notification before the message which supersedes it.
+    return {"EVAL", "local reply = redis.call('SET', KEYS[1], ARGV[1]) "
+                    "redis.call('PUBLISH', ARGV[2], ARGV[3] .. ':' .. ARGV[1]) return reply",
+            "1", key, stored, RedisHandler::publishChannel(topic_->getTopicPath()), id_};
 }
 
-std::any CacheFloat::getValue() {
-    if (topic_->check_changed_parameters().contains(id_)) {
-        value_ = std::stof(*RedisHandler::getInstance().getRedis()->get(topic_->getTopicPath() + ":" + id_));
-        topic_->removeChangedParameter(id_);
-    }
-    return value_;
+std::uint32_t ScalarCacheValue::writeEchoes_(){
+    return RedisHandler::getConfig().publish_values ? 2 : 1;
 }
 
-void CacheFloat::setValue(float value){
-    value_ = value;
-    addValueToRedis_();
+void ScalarCacheValue::addValueToRedis_(){
+    std::vector<std::string> command = writeCommand_(encodeValue_());
+    if (WriteBehindQueue* write_behind = RedisHandler::getInstance().getWriteBehind()) {
+        write_behind->enqueue(this, std::move(command));
+        return;
+    }
+    writeWithEcho_([&](sw::redis::Redis& redis){
+        redis.command<void>(command.begin(), command.end());
+    }, writeEchoes_());
+}
+
+void ScalarCacheValue::fetchValue_(){
+    auto encoded = RedisHandler::getInstance().getRedis()->get(topic_->getTopicPath() + ":" + id_);
+    // Deletion is not notified in every invalidation mode, so a missing key clears the value.
+    if (encoded)
+        applyEncoded_(*encoded);
+    else
+        clearValue_();
+}
+
+void ScalarCacheValue::fetchValueAsync_(FetchDone done){
+    RedisHandler::getInstance().getAsyncRedis()->get(topic_->getTopicPath() + ":" + id_,
+        [this, done](sw::redis::Future<sw::redis::OptionalString>&& reply){
+            auto encoded = std::make_shared<sw::redis::Future<sw::redis::OptionalString>>(std::move(reply));
+            done([this, encoded](){
+                auto value = encoded->get();
+                if (value)
+                    applyEncoded_(*value);
+                else
+                    clearValue_();
+            });
+        });
+}
+
+void ScalarCacheValue::addValueToRedisAsync_(AsyncDone done){
+    // Direct write could be overwritten by older pending write, so it is queued as well.
+    if (RedisHandler::getInstance().getWriteBehind() != nullptr) {
+        addValueToRedis_();
+        done(nullptr);
+        return;
+    }
+    std::vector<std::string> command = writeCommand_(encodeValue_());
+    writeAsync_([&](sw::redis::AsyncRedis& redis, auto&& on_reply){
+        redis.command<void>(command.begin(), command.end(), std::move(on_reply));
+    }, writeEchoes_(), std::move(done));
 }
 
-void CacheFloat::addValueToRedis_(){
-    RedisHandler::getInstance().getRedis()->set(topic_->getTopicPath() + ":" + id_, std::to_string(value_));
+char ScalarCacheValue::keyspaceEventClass_() const{
+    return '$';
 }
 
 ContainerCacheValue::ContainerCacheValue(std::string id, std::string topic_path) : AbstractCacheValue(id, topic_path){};
@@ -148,79 +410,235 @@ CacheList::CacheList(std::string id, std::string topic_path, std::list<std::stri
     addValueToRedis_();
 }
 
+CacheList::CacheList(std::string id, std::string topic_path, AttachTag) : ContainerCacheValue(id, topic_path){
+    TopicManager::getInstance().getTopic(topic_path)->addCacheValue(this);
+    markStale_();
+}
+
 void CacheList::addValueToRedis_(){
-    RedisHandler::getInstance().getRedis()->rpush(topic_->getTopicPath() + ":" + id_, value_.begin(), value_.end());
+    if (value_.empty())
+        return;
+    writeWithEcho_([&](sw::redis::Redis& redis){
+        redis.rpush(topic_->getTopicPath() + ":" + id_, value_.begin(), value_.end());
+    });
 }
 
 void CacheList::setValue(std::list<std::string> value){
-    value_ = value;
-    addValueToRedis_();
+    syncValue_();
+    if (value == value_)
+        return;
+    // Local copy was just synced, so DEL notifies if it is not empty, like RPUSH of a non-empty list.
+    std::uint32_t echoes = echoesOf_(!value_.empty() + !value.empty());
+    value_ = std::move(value);
+
+    std::string key = topic_->getTopicPath() + ":" + id_;
+    writeQueued_(RedisHandler::getInstance().getRedis()->transaction(true, false), echoes, [&](auto& transaction){
+        transaction.del(key);
+        if (!value_.empty())
+            transaction.rpush(key, value_.begin(), value_.end());
+    });
 }
 
 std::any CacheList::getValue(){
-    if (topic_->check_changed_parameters().contains(id_)) {
+    syncValue_();
+    return value_;
+}
+
+const std::list<std::string>& CacheList::view(){
+    syncValue_();
+    return value_;
+}
+
+void CacheList::fetchValue_(){
+    value_.clear();
+    RedisHandler::getInstance().getRedis()->lrange(topic_->getTopicPath() + ":" + id_, 0, -1, std::back_inserter(value_));
+}
+
+void CacheList::fetchValueAsync_(FetchDone done){
+    RedisHandler::getInstance().getAsyncRedis()->lrange<std::list<std::string>>(topic_->getTopicPath() + ":" + id_, 0, -1,
+        [this, done](sw::redis::Future<std::list<std::string>>&& reply){
+            auto value = std::make_shared<sw::redis::Future<std::list<std::string>>>(std::move(reply));
+            done([this, value](){
+                value_ = value->get();
+            });
+        });
+}
+
+bool CacheList::fetchDelta_(KeyEvent event){
+    if (value_.empty() || (event != KeyEvent::Appended && event != KeyEvent::Prepended &&
+                           event != KeyEvent::PoppedTail && event != KeyEvent::PoppedHead))
+        return false;
+
+    std::string key = topic_->getTopicPath() + ":" + id_;
+    long long size = static_cast<long long>(value_.size());
+    // Transaction makes the length, the ends and the delta a consistent snapshot of the list.
+    auto transaction = RedisHandler::getInstance().getRedis()->transaction(true, false);
+    transaction.llen(key).lindex(key, 0).lindex(key, -1);
+    if (event == KeyEvent::Appended)
+        transaction.lrange(key, size - 1, -1);
+    else if (event == KeyEvent::Prepended)
+        transaction.lrange(key, 0, -size);
+    auto replies = transaction.exec();
+
+    long long length = replies.get<long long>(0);
+    auto first = replies.get<sw::redis::OptionalString>(1);
+    auto last = replies.get<sw::redis::OptionalString>(2);
+    if (length == 0) {
         value_.clear();
-        RedisHandler::getInstance().getRedis()->lrange(topic_->getTopicPath() + ":" + id_, 0, -1, std::back_inserter(value_));
-        topic_->removeChangedParameter(id_);
+        return true;
     }
-    return value_;
+
+    if (event == KeyEvent::Appended) {
+        // Delta starts with the last known element, which has to be where local copy expects it.
+        std::list<std::string> delta;
+        replies.get(3, std::back_inserter(delta));
+        if (delta.empty() || delta.front() != value_.back() || *first != value_.front() ||
+            length != size - 1 + static_cast<long long>(delta.size()))
+            return false;
+        value_.splice(value_.end(), delta, std::next(delta.begin()), delta.end());
+        return true;
+    }
+    if (event == KeyEvent::Prepended) {
+        // Delta ends with the first known element.
+        std::list<std::string> delta;
+        replies.get(3, std::back_inserter(delta));
+        if (delta.empty() || delta.back() != value_.front() || *last != value_.back() ||
+            length != size - 1 + static_cast<long long>(delta.size()))
+            return false;
+        delta.pop_back();
+        value_.splice(value_.begin(), delta);
+        return true;
+    }
+
+    if (length > size)
+        return false;
+    if (event == KeyEvent::PoppedTail) {
+        auto new_end = std::next(value_.begin(), length);
+        if (*first != value_.front() || *last != *std::prev(new_end))
+            return false;
+        value_.erase(new_end, value_.end());
+        return true;
+    }
+    auto new_begin = std::next(value_.begin(), size - length);
+    if (*first != *new_begin || *last != value_.back())
+        return false;
+    value_.erase(value_.begin(), new_begin);
+    return true;
+}
+
+void CacheList::queueFetch_(sw::redis::Pipeline& pipeline){
+    pipeline.lrange(topic_->getTopicPath() + ":" + id_, 0, -1);
+}
+
+void CacheList::applyFetch_(sw::redis::QueuedReplies& replies, std::size_t index){
+    value_.clear();
+    replies.get(index, std::back_inserter(value_));
+}
+
+void CacheList::clearValue_(){
+    value_.clear();
+}
+
+char CacheList::keyspaceEventClass_() const{
+    return 'l';
 }
 
 void CacheList::rpush(std::string value){
-    RedisHandler::getInstance().getRedis()->rpush(topic_->getTopicPath() + ":" + id_, value);
+    writeWithEcho_([&](sw::redis::Redis& redis){
+        redis.rpush(topic_->getTopicPath() + ":" + id_, value);
+    });
+    value_.push_back(value);
+}
+
+std::future<void> CacheList::rpushAsync(std::string value){
+    return futureOf_([&](AsyncDone done){
+        rpushAsync_(value, std::move(done));
+    });
+}
+
+CacheAwaitable<void> CacheList::rpushAwait(std::string value){
+    return CacheAwaitable<void>(false, [this, value](AsyncDone done){
+        rpushAsync_(value, std::move(done));
+    }, [](){});
+}
+
+void CacheList::rpushAsync_(std::string value, AsyncDone done){
+    value_.push_back(value);
+    writeAsync_([&](sw::redis::AsyncRedis& redis, auto&& on_reply){
+        redis.rpush(topic_->getTopicPath() + ":" + id_, value, std::move(on_reply));
+    }, 1, std::move(done));
 }
 
 std::string CacheList::rpop(){
     std::string value = *RedisHandler::getInstance().getRedis()->rpop(topic_->getTopicPath() + ":" + id_);
+    logChange_();
+    if (!value_.empty())
+        value_.pop_back();
     return value;
 }
 
 void CacheList::lpush(std::string value){
-    RedisHandler::getInstance().getRedis()->lpush(topic_->getTopicPath() + ":" + id_, value);
+    writeWithEcho_([&](sw::redis::Redis& redis){
+        redis.lpush(topic_->getTopicPath() + ":" + id_, value);
+    });
+    value_.push_front(value);
+}
+
+std::future<void> CacheList::lpushAsync(std::string value){
+    return futureOf_([&](AsyncDone done){
+        lpushAsync_(value, std::move(done));
+    });
+}
+
+CacheAwaitable<void> CacheList::lpushAwait(std::string value){
+    return CacheAwaitable<void>(false, [this, value](AsyncDone done){
+        lpushAsync_(value, std::move(done));
+    }, [](){});
+}
+
+void CacheList::lpushAsync_(std::string value, AsyncDone done){
+    value_.push_front(value);
+    writeAsync_([&](sw::redis::AsyncRedis& redis, auto&& on_reply){
+        redis.lpush(topic_->getTopicPath() + ":" + id_, value, std::move(on_reply));
+    }, 1, std::move(done));
 }
 
 std::string CacheList::lpop(){
     std::string value = *RedisHandler::getInstance().getRedis()->lpop(topic_->getTopicPath() + ":" + id_);
+    logChange_();
+    if (!value_.empty())
+        value_.pop_front();
     return value;
 }
 
 int CacheList::size(){
-    if (topic_->check_changed_parameters().contains(id_)) {
-        value_.clear();
-        RedisHandler::getInstance().getRedis()->lrange(topic_->getTopicPath() + ":" + id_, 0, -1, std::back_inserter(value_));
-        topic_->removeChangedParameter(id_);
-    }
+    syncValue_();
     return static_cast<int>(value_.size());
 }
 
 bool CacheList::empty(){
-    if (topic_->check_changed_parameters().contains(id_)) {
-        value_.clear();
-        RedisHandler::getInstance().getRedis()->lrange(topic_->getTopicPath() + ":" + id_, 0, -1, std::back_inserter(value_));
-        topic_->removeChangedParameter(id_);
-    }
+    syncValue_();
     return value_.empty();
 }
 
 bool CacheList::contains(std::string value){
-    if (topic_->check_changed_parameters().contains(id_)) {
-        value_.clear();
-        RedisHandler::getInstance().getRedis()->lrange(topic_->getTopicPath() + ":" + id_, 0, -1, std::back_inserter(value_));
-        topic_->removeChangedParameter(id_);
-    }
+    syncValue_();
     return std::find(value_.begin(), value_.end(), value) != value_.end();
 }
 
 void CacheList::clear(){
     value_.clear();
     RedisHandler::getInstance().getRedis()->del(topic_->getTopicPath() + ":" + id_);
+    logChange_();
 }
 
 
 void CacheMap::addValueToRedis_(){
-    for(const auto& pair : value_){
-        RedisHandler::getInstance().getRedis()->hset(topic_->getTopicPath() + ":" + id_, pair.first, pair.second);
-    }
+    if (value_.empty())
+        return;
+    writeWithEcho_([&](sw::redis::Redis& redis){
+        redis.hset(topic_->getTopicPath() + ":" + id_, value_.begin(), value_.end());
+    });
 }
 
 CacheMap::CacheMap(std::string id, std::string topic_path, std::map<std::string, std::string> value) : ContainerCacheValue(id, topic_path){
@@ -229,31 +647,110 @@ CacheMap::CacheMap(std::string id, std::string topic_path, std::map<std::string,
     addValueToRedis_();
 }
 
+CacheMap::CacheMap(std::string id, std::string topic_path, AttachTag) : ContainerCacheValue(id, topic_path){
+    TopicManager::getInstance().getTopic(topic_path)->addCacheValue(this);
+    markStale_();
+}
+
 void CacheMap::setValue(std::map<std::string, std::string> value){
-    value_ = value;
-    addValueToRedis_();
+    syncValue_();
+    std::vector<std::string> removed;
+    for (const auto& [key, val] : value_) {
+        if (value.find(key) == value.end())
+            removed.push_back(key);
+    }
+    std::vector<std::pair<std::string, std::string>> changed;
+    for (const auto& [key, val] : value) {
+        auto it = value_.find(key);
+        if (it == value_.end() || it->second != val)
+            changed.emplace_back(key, val);
+    }
+    // Removed fields are taken from local copy which was just synced, so HDEL deletes them and notifies, like HSET.
+    // HDEL of every field deletes the key, which is notified as well.
+    std::uint32_t echoes = echoesOf_(!removed.empty() + (!removed.empty() && removed.size() == value_.size()) + !changed.empty());
+    value_ = std::move(value);
+    if (removed.empty() && changed.empty())
+        return;
+
+    std::string key = topic_->getTopicPath() + ":" + id_;
+    writeQueued_(RedisHandler::getInstance().getRedis()->pipeline(false), echoes, [&](auto& pipeline){
+        if (!removed.empty())
+            pipeline.hdel(key, removed.begin(), removed.end());
+        if (!changed.empty())
+            pipeline.hset(key, changed.begin(), changed.end());
+    });
 }
 
 std::any CacheMap::getValue(){
-    if (topic_->check_changed_parameters().contains(id_)) {
-        value_.clear();
-        RedisHandler::getInstance().getRedis()->hgetall(topic_->getTopicPath() + ":" + id_, std::inserter(value_, value_.begin()));
-        topic_->removeChangedParameter(id_);
-    }
+    syncValue_();
     return value_;
 }
 
+const std::map<std::string, std::string>& CacheMap::view(){
+    syncValue_();
+    return value_;
+}
+
+void CacheMap::fetchValue_(){
+    value_.clear();
+    RedisHandler::getInstance().getRedis()->hgetall(topic_->getTopicPath() + ":" + id_, std::inserter(value_, value_.begin()));
+}
+
+void CacheMap::fetchValueAsync_(FetchDone done){
+    RedisHandler::getInstance().getAsyncRedis()->hgetall<std::map<std::string, std::string>>(topic_->getTopicPath() + ":" + id_,
+        [this, done](sw::redis::Future<std::map<std::string, std::string>>&& reply){
+            auto value = std::make_shared<sw::redis::Future<std::map<std::string, std::string>>>(std::move(reply));
+            done([this, value](){
+                value_ = value->get();
+            });
+        });
+}
+
+void CacheMap::queueFetch_(sw::redis::Pipeline& pipeline){
+    pipeline.hgetall(topic_->getTopicPath() + ":" + id_);
+}
+
+void CacheMap::applyFetch_(sw::redis::QueuedReplies& replies, std::size_t index){
+    value_.clear();
+    replies.get(index, std::inserter(value_, value_.begin()));
+}
+
+void CacheMap::clearValue_(){
+    value_.clear();
+}
+
+char CacheMap::keyspaceEventClass_() const{
+    return 'h';
+}
+
 void CacheMap::addKey(std::string key, std::string val){
     value_[key] = val;
-    RedisHandler::getInstance().getRedis()->hset(topic_->getTopicPath() + ":" + id_, key, val);
+    writeWithEcho_([&](sw::redis::Redis& redis){
+        redis.hset(topic_->getTopicPath() + ":" + id_, key, val);
+    });
+}
+
+std::future<void> CacheMap::addKeyAsync(std::string key, std::string val){
+    return futureOf_([&](AsyncDone done){
+        addKeyAsync_(key, val, std::move(done));
+    });
+}
+
+CacheAwaitable<void> CacheMap::addKeyAwait(std::string key, std::string val){
+    return CacheAwaitable<void>(false, [this, key, val](AsyncDone done){
+        addKeyAsync_(key, val, std::move(done));
+    }, [](){});
+}
+
+void CacheMap::addKeyAsync_(std::string key, std::string val, AsyncDone done){
+    value_[key] = val;
+    writeAsync_([&](sw::redis::AsyncRedis& redis, auto&& on_reply){
+        redis.hset(topic_->getTopicPath() + ":" + id_, key, val, std::move(on_reply));
+    }, 1, std::move(done));
 }
 
 bool CacheMap::contains(std::string key){
-    if (topic_->check_changed_parameters().contains(id_)) {
-        value_.clear();
-        RedisHandler::getInstance().getRedis()->hgetall(topic_->getTopicPath() + ":" + id_, std::inserter(value_, value_.begin()));
-        topic_->removeChangedParameter(id_);
-    }
+    syncValue_();
     return value_.find(key) != value_.end();
 }
 
@@ -262,15 +759,12 @@ void CacheMap::eraseKey(std::string key){
     if (it != value_.end()) {
         value_.erase(it);
         RedisHandler::getInstance().getRedis()->hdel(topic_->getTopicPath() + ":" + id_, key);
+        logChange_();
     }
 }
 
 std::string CacheMap::getKey(std::string key){
-    if (topic_->check_changed_parameters().contains(id_)) {
-        value_.clear();
-        RedisHandler::getInstance().getRedis()->hgetall(topic_->getTopicPath() + ":" + id_, std::inserter(value_, value_.begin()));
-        topic_->removeChangedParameter(id_);
-    }
+    syncValue_();
     auto it = value_.find(key);
     if (it != value_.end()) {
         return it->second;
@@ -281,32 +775,26 @@ std::string CacheMap::getKey(std::string key){
 }
 
 int CacheMap::size(){
-    if (topic_->check_changed_parameters().contains(id_)) {
-        value_.clear();
-        RedisHandler::getInstance().getRedis()->hgetall(topic_->getTopicPath() + ":" + id_, std::inserter(value_, value_.begin()));
-        topic_->removeChangedParameter(id_);
-    }
+    syncValue_();
     return static_cast<int>(value_.size());
 }
 
 bool CacheMap::empty(){
-    if (topic_->check_changed_parameters().contains(id_)) {
-        value_.clear();
-        RedisHandler::getInstance().getRedis()->hgetall(topic_->getTopicPath() + ":" + id_, std::inserter(value_, value_.begin()));
-        topic_->removeChangedParameter(id_);
-    }
+    syncValue_();
     return value_.empty();
 }
 
 void CacheMap::clear(){
     value_.clear();
     RedisHandler::getInstance().getRedis()->del(topic_->getTopicPath() + ":" + id_);
+    logChange_();
 }
 
 void CacheSet::addValueToRedis_(){
-    for(const auto& val : value_){
-        RedisHandler::getInstance().getRedis()->sadd(topic_->getTopicPath() + ":" + id_, val);
-    }
+    if (value_.empty())
+        return;
+    RedisHandler::getInstance().getRedis()->sadd(topic_->getTopicPath() + ":" + id_, value_.begin(), value_.end());
+    logChange_();
 }
 
 CacheSet::CacheSet(std::string id, std::string topic_path, std::set<std::string> value) : ContainerCacheValue(id, topic_path){
@@ -315,58 +803,124 @@ CacheSet::CacheSet(std::string id, std::string topic_path, std::set<std::string>
     addValueToRedis_();
 }
 
+CacheSet::CacheSet(std::string id, std::string topic_path, AttachTag) : ContainerCacheValue(id, topic_path){
+    TopicManager::getInstance().getTopic(topic_path)->addCacheValue(this);
+    markStale_();
+}
+
 std::any CacheSet::getValue(){
-    if (topic_->check_changed_parameters().contains(id_)) {
-        value_.clear();
-        RedisHandler::getInstance().getRedis()->smembers(topic_->getTopicPath() + ":" + id_, std::inserter(value_, value_.begin()));
-        topic_->removeChangedParameter(id_);
-    }
+    syncValue_();
     return value_;
 }
 
+const std::set<std::string>& CacheSet::view(){
+    syncValue_();
+    return value_;
+}
+
+void CacheSet::fetchValue_(){
+    value_.clear();
+    RedisHandler::getInstance().getRedis()->smembers(topic_->getTopicPath() + ":" + id_, std::inserter(value_, value_.begin()));
+}
+
+void CacheSet::fetchValueAsync_(FetchDone done){
+    RedisHandler::getInstance().getAsyncRedis()->smembers<std::set<std::string>>(topic_->getTopicPath() + ":" + id_,
+        [this, done](sw::redis::Future<std::set<std::string>>&& reply){
+            auto value = std::make_shared<sw::redis::Future<std::set<std::string>>>(std::move(reply));
+            done([this, value](){
+                value_ = value->get();
+            });
+        });
+}
+
+void CacheSet::queueFetch_(sw::redis::Pipeline& pipeline){
+    pipeline.smembers(topic_->getTopicPath() + ":" + id_);
+}
+
+void CacheSet::applyFetch_(sw::redis::QueuedReplies& replies, std::size_t index){
+    value_.clear();
+    replies.get(index, std::inserter(value_, value_.begin()));
+}
+
+void CacheSet::clearValue_(){
+    value_.clear();
+}
+
+char CacheSet::keyspaceEventClass_() const{
+    return 's';
+}
+
 void CacheSet::setValue(std::set<std::string> value){
-    value_ = value;
-    addValueToRedis_();
+    syncValue_();
+    std::vector<std::string> removed;
+    std::set_difference(value_.begin(), value_.end(), value.begin(), value.end(), std::back_inserter(removed));
+    std::vector<std::string> added;
+    std::set_difference(value.begin(), value.end(), value_.begin(), value_.end(), std::back_inserter(added));
+    // Difference is taken against local copy which was just synced, so SREM and SADD both change the set and notify.
+    // SREM of every member deletes the key, which is notified as well.
+    std::uint32_t echoes = echoesOf_(!removed.empty() + (!removed.empty() && removed.size() == value_.size()) + !added.empty());
+    value_ = std::move(value);
+    if (removed.empty() && added.empty())
+        return;
+
+    std::string key = topic_->getTopicPath() + ":" + id_;
+    writeQueued_(RedisHandler::getInstance().getRedis()->pipeline(false), echoes, [&](auto& pipeline){
+        if (!removed.empty())
+            pipeline.srem(key, removed.begin(), removed.end());
+        if (!added.empty())
+            pipeline.sadd(key, added.begin(), added.end());
+    });
 }
 
 void CacheSet::addValue(std::string val){
     value_.insert(val);
     RedisHandler::getInstance().getRedis()->sadd(topic_->getTopicPath() + ":" + id_, val);
+    logChange_();
+}
+
+std::future<void> CacheSet::addValueAsync(std::string val){
+    return futureOf_([&](AsyncDone done){
+        addValueAsync_(val, std::move(done));
+    });
+}
+
+CacheAwaitable<void> CacheSet::addValueAwait(std::string val){
+    return CacheAwaitable<void>(false, [this, val](AsyncDone done){
+        addValueAsync_(val, std::move(done));
+    }, [](){});
+}
+
+void CacheSet::addValueAsync_(std::string val, AsyncDone done){
+    value_.insert(val);
+    // Adding a member which is already in the set does not notify, so the echo cannot be expected.
+    writeAsync_([&](sw::redis::AsyncRedis& redis, auto&& on_reply){
+        redis.sadd(topic_->getTopicPath() + ":" + id_, val, std::move(on_reply));
+    }, 0, std::move(done));
 }
 
 void CacheSet::removeValue(std::string val){
     value_.erase(val);
     RedisHandler::getInstance().getRedis()->srem(topic_->getTopicPath() + ":" + id_, val);
+    logChange_();
 }
 
 bool CacheSet::contains(std::string val){
-    if (topic_->check_changed_parameters().contains(id_)) {
-        value_.clear();
-        RedisHandler::getInstance().getRedis()->smembers(topic_->getTopicPath() + ":" + id_, std::inserter(value_, value_.begin()));
-        topic_->removeChangedParameter(id_);
-    }
+    syncValue_();
     return value_.find(val) != value_.end();
 }
 
 int CacheSet::size(){
-    if (topic_->check_changed_parameters().contains(id_)) {
-        value_.clear();
-        RedisHandler::getInstance().getRedis()->smembers(topic_->getTopicPath() + ":" + id_, std::inserter(value_, value_.begin()));
-        topic_->removeChangedParameter(id_);
-    }
+    syncValue_();
     return static_cast<int>(value_.size());
 }
 
 bool CacheSet::empty(){
-    if (topic_->check_changed_parameters().contains(id_)) {
-        value_.clear();
-        RedisHandler::getInstance().getRedis()->smembers(topic_->getTopicPath() + ":" + id_, std::inserter(value_, value_.begin()));
-        topic_->removeChangedParameter(id_);
-    }
+    syncValue_();
     return value_.empty();
 }
 
 void CacheSet::clear(){
     value_.clear();
     RedisHandler::getInstance().getRedis()->del(topic_->getTopicPath() + ":" + id_);
+    logChange_();
 }
\ No newline at end of file
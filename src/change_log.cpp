@@ -0,0 +1,181 @@
+#include <change_log.h>
+#include <keyspace_channel.h>
+#include <topic_manager.h>
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <optional>
+#include <unordered_map>
+
+namespace
+{
+using Attrs = std::vector<std::pair<std::string, std::string>>;
+using Item = std::pair<std::string, sw::redis::Optional<Attrs>>;
+using ItemStream = std::vector<Item>;
+}
+
+ChangeLog::ChangeLog(sw::redis::Redis* redis, const sw::redis::ConnectionOptions& options, long long max_length, std::chrono::milliseconds block)
+    : redis_(redis), reader_(options), max_length_(max_length), block_(block), read_count_(1024), stop_(false)
+{
+    thread_ = std::thread(&ChangeLog::worker_, this);
+}
+
+ChangeLog::~ChangeLog()
+{
+    stop_ = true;
+    thread_.join();
+}
+
+std::string ChangeLog::streamKey(const std::string& topic_path)
+{
+    return "__cachemonitor__:log:" + topic_path;
+}
+
+void ChangeLog::append(const std::string& topic_path, const std::string& id)
+{
+    std::vector<std::pair<std::string, std::string>> fields = {{"id", id}};
+    redis_->xadd(streamKey(topic_path), "*", fields.begin(), fields.end(), max_length_, true);
+}
+
+void ChangeLog::appendAsync(sw::redis::AsyncRedis& redis, const std::string& topic_path, const std::string& id)
+{
+    auto on_reply = [](sw::redis::Future<std::string>&& reply)
+    {
+        try
+        {
+            reply.get();
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Change log append failed: " << e.what() << std::endl;
+        }
+    };
+    redis.command<std::string>("XADD", streamKey(topic_path), "MAXLEN", "~", std::to_string(max_length_), "*", "id", id, on_reply);
+}
+
+void ChangeLog::subscribe(const std::string& topic_path)
+{
+    std::string key = streamKey(topic_path);
+    // Offset is taken now, so changes made after subscribing are read even before the thread picks the stream up.
+    std::string offset = lastEntry_(key);
+    std::lock_guard lock(mutex_);
+    offsets_.try_emplace(key, offset);
+}
+
+void ChangeLog::unsubscribe(const std::string& topic_path)
+{
+    std::lock_guard lock(mutex_);
+    offsets_.erase(streamKey(topic_path));
+}
+
+void ChangeLog::worker_()
+{
+    bool resync = false;
+    int failures = 0;
+    while (!stop_)
+    {
+        try
+        {
+            read_(resync);
+            resync = false;
+            failures = 0;
+        }
+        catch (const sw::redis::Error& e)
+        {
+            std::cerr << "Change log read failed: " << e.what() << std::endl;
+            // Entries are read from the last offset after reconnecting, only trimmed ones have to be checked.
+            resync = true;
+            std::this_thread::sleep_for(std::min(std::chrono::milliseconds(10 << std::min(failures++, 8)), std::chrono::milliseconds(2000)));
+        }
+    }
+}
+
+void ChangeLog::read_(bool resync)
+{
+    std::vector<std::pair<std::string, std::string>> offsets;
+    {
+        std::lock_guard lock(mutex_);
+        offsets.assign(offsets_.begin(), offsets_.end());
+    }
+    if (offsets.empty())
+    {
+        std::this_thread::sleep_for(block_);
+        return;
+    }
+    if (resync)
+    {
+        for (const auto& [key, offset] : offsets)
+            checkTrimmed_(key, offset);
+    }
+
+    std::unordered_map<std::string, ItemStream> streams;
+    reader_.xread(offsets.begin(), offsets.end(), block_, read_count_, std::inserter(streams, streams.end()));
+
+    std::vector<KeyspaceChannel> changes;
+    for (auto& [key, items] : streams)
+    {
+        if (items.empty())
+            continue;
+        std::string topic_path = key.substr(streamKey("").size());
+        changes.clear();
+        for (const auto& [entry, attrs] : items)
+        {
+            if (!attrs)
+                continue;
+            for (const auto& [field, value] : *attrs)
+            {
+                if (field == "id")
+                {
+                    KeyspaceChannel change;
+                    change.topic_path = topic_path;
+                    change.id = value;
+                    changes.push_back(change);
+                }
+            }
+        }
+        TopicManager::getInstance().addChangedParameters(topic_path, changes);
+
+        {
+            std::lock_guard lock(mutex_);
+            auto it = offsets_.find(key);
+            if (it != offsets_.end())
+                it->second = items.back().first;
+        }
+        // Full read means the reader is behind, so older entries may be trimmed before it gets to them.
+        if (static_cast<long long>(items.size()) >= read_count_)
+            checkTrimmed_(key, items.back().first);
+    }
+}
+
+void ChangeLog::checkTrimmed_(const std::string& key, const std::string& offset)
+{
+    std::vector<Item> first;
+    reader_.xrange(key, "-", "+", 1, std::back_inserter(first));
+    // Only streams at their maximum length are trimmed, and then the entries after the offset may be gone.
+    if (first.empty() || compareEntries_(first.front().first, offset) <= 0 || reader_.xlen(key) < max_length_)
+        return;
+    TopicManager::getInstance().markAllChanged(key.substr(streamKey("").size()));
+}
+
+std::string ChangeLog::lastEntry_(const std::string& key)
+{
+    std::vector<Item> last;
+    redis_->xrevrange(key, "+", "-", 1, std::back_inserter(last));
+    return last.empty() ? "0-0" : last.front().first;
+}
+
+int ChangeLog::compareEntries_(const std::string& lhs, const std::string& rhs)
+{
+    auto split = [](const std::string& entry)
+    {
+        std::size_t separator = entry.find('-');
+        std::uint64_t time = std::stoull(entry.substr(0, separator));
+        std::uint64_t sequence = separator == std::string::npos ? 0 : std::stoull(entry.substr(separator + 1));
+        return std::make_pair(time, sequence);
+    };
+    auto lhs_parts = split(lhs);
+    auto rhs_parts = split(rhs);
+    if (lhs_parts == rhs_parts)
+        return 0;
+    return lhs_parts < rhs_parts ? -1 : 1;
+}
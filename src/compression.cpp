@@ -0,0 +1,131 @@
+#include <compression.h>
+#include <lz4.h>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+/**
+ * @brief Marker at the start of values stored with a header.
+ */
+constexpr char header_marker[] = {'\xff', 'C', 'M', 'Z'};
+
+/**
+ * @brief Size of the header: marker, format byte and 4 bytes of the original size.
+ */
+constexpr std::size_t header_size = sizeof(header_marker) + 1 + 4;
+
+/**
+ * @brief Format byte of values stored as they are, behind the header.
+ */
+constexpr char stored_format = 'S';
+
+/**
+ * @brief Format byte of values compressed with LZ4.
+ */
+constexpr char lz4_format = 'L';
+
+std::uint64_t elapsedNanoseconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+}
+
+Compression::Compression(std::size_t threshold) : compressed_writes_(0), raw_bytes_(0), compressed_bytes_(0), compress_nanoseconds_(0),
+                                                  decompressed_reads_(0), decompress_nanoseconds_(0), threshold_(threshold)
+{
+}
+
+void Compression::setThreshold(std::size_t threshold)
+{
+    threshold_ = threshold;
+}
+
+std::size_t Compression::getThreshold() const
+{
+    return threshold_;
+}
+
+bool Compression::hasHeader_(const std::string& value)
+{
+    return value.size() >= sizeof(header_marker) && std::memcmp(value.data(), header_marker, sizeof(header_marker)) == 0;
+}
+
+bool Compression::isPacked(const std::string& stored)
+{
+    return hasHeader_(stored);
+}
+
+std::string Compression::withHeader_(char format, std::size_t raw_size, const char* payload, std::size_t payload_size)
+{
+    std::string value(header_size + payload_size, '\0');
+    std::memcpy(value.data(), header_marker, sizeof(header_marker));
+    value[sizeof(header_marker)] = format;
+    for (std::size_t i = 0; i < 4; ++i)
+        value[sizeof(header_marker) + 1 + i] = static_cast<char>((raw_size >> (8 * i)) & 0xff);
+    std::memcpy(value.data() + header_size, payload, payload_size);
+    return value;
+}
+
+std::string Compression::pack(const std::string& encoded)
+{
+    // LZ4 block format limits the size of the input, bigger values are stored as they are.
+    if (threshold_ > 0 && encoded.size() >= threshold_ && encoded.size() <= LZ4_MAX_INPUT_SIZE)
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::string compressed(LZ4_compressBound(static_cast<int>(encoded.size())), '\0');
+        int size = LZ4_compress_default(encoded.data(), compressed.data(), static_cast<int>(encoded.size()), static_cast<int>(compressed.size()));
+        bool smaller = size > 0 && header_size + static_cast<std::size_t>(size) < encoded.size();
+        std::string stored = smaller ? withHeader_(lz4_format, encoded.size(), compressed.data(), size) : std::string();
+        compress_nanoseconds_.fetch_add(elapsedNanoseconds(start), std::memory_order_relaxed);
+        if (smaller)
+        {
+            compressed_writes_.fetch_add(1, std::memory_order_relaxed);
+            raw_bytes_.fetch_add(encoded.size(), std::memory_order_relaxed);
+            compressed_bytes_.fetch_add(stored.size(), std::memory_order_relaxed);
+            return stored;
+        }
+    }
+    if (hasHeader_(encoded))
+        return withHeader_(stored_format, encoded.size(), encoded.data(), encoded.size());
+    return encoded;
+}
+
+std::string Compression::unpack(const std::string& stored)
+{
+    if (stored.size() < header_size)
+        throw std::runtime_error("Compressed value is shorter than its header");
+    std::size_t raw_size = 0;
+    for (std::size_t i = 0; i < 4; ++i)
+        raw_size |= static_cast<std::size_t>(static_cast<unsigned char>(stored[sizeof(header_marker) + 1 + i])) << (8 * i);
+    const char* payload = stored.data() + header_size;
+    std::size_t payload_size = stored.size() - header_size;
+
+    char format = stored[sizeof(header_marker)];
+    if (format == stored_format)
+        return std::string(payload, payload_size);
+    if (format != lz4_format || raw_size > LZ4_MAX_INPUT_SIZE)
+        throw std::runtime_error("Compressed value has unknown format");
+
+    auto start = std::chrono::steady_clock::now();
+    std::string encoded(raw_size, '\0');
+    int size = LZ4_decompress_safe(payload, encoded.data(), static_cast<int>(payload_size), static_cast<int>(raw_size));
+    if (size < 0 || static_cast<std::size_t>(size) != raw_size)
+        throw std::runtime_error("Compressed value is corrupted");
+    decompressed_reads_.fetch_add(1, std::memory_order_relaxed);
+    decompress_nanoseconds_.fetch_add(elapsedNanoseconds(start), std::memory_order_relaxed);
+    return encoded;
+}
+
+CompressionStats Compression::getStats() const
+{
+    CompressionStats stats;
+    stats.compressed_writes = compressed_writes_.load(std::memory_order_relaxed);
+    stats.raw_bytes = raw_bytes_.load(std::memory_order_relaxed);
+    stats.compressed_bytes = compressed_bytes_.load(std::memory_order_relaxed);
+    stats.compress_nanoseconds = compress_nanoseconds_.load(std::memory_order_relaxed);
+    stats.decompressed_reads = decompressed_reads_.load(std::memory_order_relaxed);
+    stats.decompress_nanoseconds = decompress_nanoseconds_.load(std::memory_order_relaxed);
+    return stats;
+}
@@ -0,0 +1,21 @@
+#include <keyspace_channel.h>
+
+bool KeyspaceChannel::parse(std::string_view channel, KeyspaceChannel& result){
+    std::size_t topic_begin = channel.find(':');
+    if (topic_begin == std::string_view::npos)
+        return false;
+    channel.remove_prefix(topic_begin + 1);
+    return parseKey(channel, result);
+}
+
+bool KeyspaceChannel::parseKey(std::string_view key, KeyspaceChannel& result){
+    std::size_t topic_end = key.find(':');
+    result.topic_path = key.substr(0, topic_end);
+    if (topic_end == std::string_view::npos) {
+        result.id = std::string_view();
+        return true;
+    }
+    key.remove_prefix(topic_end + 1);
+    result.id = key.substr(0, key.find(':'));
+    return true;
+}
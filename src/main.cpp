@@ -3,12 +3,58 @@
 #include <topic_manager.h>
 #include <cache_value.h>
 #include <topic.h>
+#include <write_batch.h>
+#include <write_behind_queue.h>
+#include <change_log.h>
 #include <thread>
 #include <chrono>
 #include <memory>
 #include <sstream>
+#include <future>
+#include <coroutine>
 #include <gtest/gtest.h>
 
+/**
+ * @brief Coroutine running eagerly without any result, used to test awaitable cache operations.
+ */
+struct DetachedCoroutine
+{
+    struct promise_type
+    {
+        DetachedCoroutine get_return_object() { return {}; }
+        std::suspend_never initial_suspend() { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::terminate(); }
+    };
+};
+
+/**
+ * @brief Point stored by a user codec, used to test custom value types.
+ */
+struct TestPoint
+{
+    int x;
+    int y;
+};
+
+/**
+ * @brief Codec storing `TestPoint` as `x,y`.
+ */
+struct TestPointCodec
+{
+    static std::string encode(const TestPoint& point)
+    {
+        return std::to_string(point.x) + "," + std::to_string(point.y);
+    }
+
+    static TestPoint decode(const std::string& encoded)
+    {
+        std::size_t separator = encoded.find(',');
+        return {std::stoi(encoded.substr(0, separator)), std::stoi(encoded.substr(separator + 1))};
+    }
+};
+
 class TestCacheMonitor : public ::testing::Test
 {
 protected:
@@ -148,7 +194,15 @@ TEST_F(TestCacheMonitor, CheckChangedParameters)
     TopicManager::getInstance().createTopic("changed_parameters_topic");
     ASSERT_EQ(0, TopicManager::getInstance().getTopic("changed_parameters_topic")->check_changed_parameters().size()) << "Changed parameters topic is not empty";
 
-    std::shared_ptr<AbstractCacheValue> cache_value = std::make_shared<CacheString>("test_id", "changed_parameters_topic", "test_value");
+    std::shared_ptr<CacheString> cache_value = std::make_shared<CacheString>("test_id", "changed_parameters_topic", "test_value");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_EQ(0, TopicManager::getInstance().getTopic("changed_parameters_topic")->check_changed_parameters().size()) << "Echo of own write was not suppressed";
+
+    cache_value->setValue("new_value");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_EQ(0, TopicManager::getInstance().getTopic("changed_parameters_topic")->check_changed_parameters().size()) << "Echo of own setValue was not suppressed";
+
+    RedisHandler::getInstance().getRedis()->set("changed_parameters_topic:test_id", "another_value");
     std::this_thread::sleep_for(std::chrono::milliseconds(100));
     ASSERT_EQ(1, TopicManager::getInstance().getTopic("changed_parameters_topic")->check_changed_parameters().size()) << "Changed parameters topic does not have one parameter";
     ASSERT_TRUE(TopicManager::getInstance().getTopic("changed_parameters_topic")->check_changed_parameters().contains("test_id")) << "Changed parameters topic does not have correct parameter";
@@ -163,6 +217,696 @@ TEST_F(TestCacheMonitor, CheckGetTopicValue)
     ASSERT_EQ("another_value", TopicManager::getInstance().getTopic("get_value_topic")->getCacheValue("test_id")->toString()) << "Get value is not correct";
 }
 
+TEST_F(TestCacheMonitor, CheckValueVersion)
+{
+    TopicManager::getInstance().createTopic("version_topic");
+    auto cache_value = std::make_shared<CacheString>("test_id", "version_topic", "test_value");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_EQ("test_value", cache_value->toString()) << "Value is not correct";
+    ASSERT_FALSE(cache_value->isChanged()) << "Value is marked as changed without external write";
+
+    RedisHandler::getInstance().getRedis()->set("version_topic:test_id", "another_value");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_TRUE(cache_value->isChanged()) << "Value is not marked as changed after external write";
+    ASSERT_EQ("another_value", cache_value->toString()) << "Value after external write is not correct";
+    ASSERT_FALSE(cache_value->isChanged()) << "Value is still marked as changed after read";
+}
+
+TEST_F(TestCacheMonitor, CheckNotificationBatches)
+{
+    TopicManager::getInstance().createTopic("batch_topic");
+    std::vector<std::shared_ptr<CacheInt>> cache_values;
+    for (int i = 0; i < 100; ++i)
+        cache_values.push_back(std::make_shared<CacheInt>("test_id" + std::to_string(i), "batch_topic", i));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    NotificationStats before = RedisHandler::getInstance().getNotificationStats();
+
+    auto pipe = RedisHandler::getInstance().getRedis()->pipeline();
+    for (int i = 0; i < 100; ++i)
+        pipe.set("batch_topic:test_id" + std::to_string(i), std::to_string(i * 2));
+    pipe.exec();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    NotificationStats after = RedisHandler::getInstance().getNotificationStats();
+    ASSERT_EQ(100, after.messages - before.messages) << "Not all notifications were processed";
+    ASSERT_LT(after.batches - before.batches, 100) << "Notifications were not batched";
+    for (int i = 0; i < 100; ++i)
+        ASSERT_EQ(i * 2, cache_values[i]->toInt()) << "Value after batched notification is not correct";
+}
+
+TEST_F(TestCacheMonitor, CheckTopicSubscriptions)
+{
+    TopicManager::getInstance().createTopic("subscribed_topic");
+    auto cache_value = std::make_shared<CacheString>("test_id", "subscribed_topic", "test_value");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    NotificationStats before = RedisHandler::getInstance().getNotificationStats();
+
+    RedisHandler::getInstance().getRedis()->set("not_registered_topic:test_id", "test_value");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_EQ(before.messages, RedisHandler::getInstance().getNotificationStats().messages) << "Notification for key without topic was received";
+
+    RedisHandler::getInstance().getRedis()->set("subscribed_topic:test_id", "another_value");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_EQ(before.messages + 1, RedisHandler::getInstance().getNotificationStats().messages) << "Notification for topic key was not received";
+
+    TopicManager::getInstance().removeTopic("subscribed_topic");
+    RedisHandler::getInstance().getRedis()->set("subscribed_topic:test_id", "test_value");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_EQ(before.messages + 1, RedisHandler::getInstance().getNotificationStats().messages) << "Notification for removed topic was received";
+}
+
+TEST_F(TestCacheMonitor, CheckTopicRefresh)
+{
+    TopicManager::getInstance().createTopic("refresh_topic");
+    auto cache_string = std::make_shared<CacheString>("string_id", "refresh_topic", "test_value");
+    auto cache_int = std::make_shared<CacheInt>("int_id", "refresh_topic", 1);
+    auto cache_list = std::make_shared<CacheList>("list_id", "refresh_topic", std::list<std::string>{"a"});
+    auto cache_map = std::make_shared<CacheMap>("map_id", "refresh_topic", std::map<std::string, std::string>{{"a", "1"}});
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    RedisHandler::getInstance().getRedis()->set("refresh_topic:string_id", "another_value");
+    RedisHandler::getInstance().getRedis()->set("refresh_topic:int_id", "2");
+    RedisHandler::getInstance().getRedis()->rpush("refresh_topic:list_id", "b");
+    RedisHandler::getInstance().getRedis()->hset("refresh_topic:map_id", "b", "2");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_EQ(4, TopicManager::getInstance().getTopic("refresh_topic")->check_changed_parameters().size()) << "Not all external writes were noticed";
+
+    TopicManager::getInstance().getTopic("refresh_topic")->refresh();
+    ASSERT_EQ(0, TopicManager::getInstance().getTopic("refresh_topic")->check_changed_parameters().size()) << "Values are still changed after refresh";
+    ASSERT_EQ("another_value", cache_string->toString()) << "String after refresh is not correct";
+    ASSERT_EQ(2, cache_int->toInt()) << "Int after refresh is not correct";
+    ASSERT_EQ((std::list<std::string>{"a", "b"}), cache_list->toList()) << "List after refresh is not correct";
+    ASSERT_EQ((std::map<std::string, std::string>{{"a", "1"}, {"b", "2"}}), cache_map->toMap()) << "Map after refresh is not correct";
+
+    RedisHandler::getInstance().getRedis()->set("refresh_topic:int_id", "3");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    TopicManager::getInstance().refresh();
+    ASSERT_FALSE(cache_int->isChanged()) << "Value is still changed after refresh of all topics";
+    ASSERT_EQ(3, cache_int->toInt()) << "Int after refresh of all topics is not correct";
+}
+
+TEST_F(TestCacheMonitor, CheckTopicHydration)
+{
+    auto redis = RedisHandler::getInstance().getRedis();
+    redis->set("hydrated_topic:string_id", "test_value");
+    redis->set("hydrated_topic:int_id", "42");
+    redis->set("hydrated_topic:float_id", "1.5");
+    redis->rpush("hydrated_topic:list_id", "a");
+    redis->hset("hydrated_topic:map_id", "a", "1");
+    redis->sadd("hydrated_topic:set_id", "a");
+    redis->set("hydrated_topic:nested:id", "test_value");
+
+    auto cache_values = TopicManager::getInstance().hydrateTopic("hydrated_topic");
+    ASSERT_EQ(6, cache_values.size()) << "Not all values were hydrated";
+    Topic* topic = TopicManager::getInstance().getTopic("hydrated_topic");
+    ASSERT_EQ("test_value", topic->getCacheValue("string_id")->toString()) << "Hydrated string is not correct";
+    ASSERT_EQ("42", topic->getCacheValue("int_id")->toString()) << "Hydrated int is not attached as string";
+    ASSERT_EQ("1.5", topic->getCacheValue("float_id")->toString()) << "Hydrated float is not attached as string";
+    ASSERT_EQ(std::list<std::string>{"a"}, topic->getCacheValue("list_id")->toList()) << "Hydrated list is not correct";
+    ASSERT_EQ((std::map<std::string, std::string>{{"a", "1"}}), topic->getCacheValue("map_id")->toMap()) << "Hydrated map is not correct";
+    ASSERT_EQ(std::set<std::string>{"a"}, topic->getCacheValue("set_id")->toSet()) << "Hydrated set is not correct";
+    ASSERT_EQ("1.5", *redis->get("hydrated_topic:float_id")) << "Hydration wrote value back to Redis";
+    ASSERT_EQ(0, topic->check_changed_parameters().size()) << "Hydrated values are marked as changed";
+}
+
+TEST_F(TestCacheMonitor, CheckAttachedValues)
+{
+    TopicManager::getInstance().createTopic("attached_topic");
+    RedisHandler::getInstance().getRedis()->set("attached_topic:int_id", "42");
+    RedisHandler::getInstance().getRedis()->rpush("attached_topic:list_id", "a");
+
+    auto cache_int = std::make_shared<CacheInt>("int_id", "attached_topic", AttachTag());
+    auto cache_list = std::make_shared<CacheList>("list_id", "attached_topic", AttachTag());
+    auto cache_missing = std::make_shared<CacheString>("missing_id", "attached_topic", AttachTag());
+    ASSERT_TRUE(cache_int->isChanged()) << "Attached value is not fetched on first read";
+    ASSERT_EQ("42", *RedisHandler::getInstance().getRedis()->get("attached_topic:int_id")) << "Attaching wrote value to Redis";
+    ASSERT_EQ(42, cache_int->toInt()) << "Attached int is not correct";
+    ASSERT_EQ(std::list<std::string>{"a"}, cache_list->toList()) << "Attached list is not correct";
+    ASSERT_EQ("", cache_missing->toString()) << "Value attached to missing key is not empty";
+    ASSERT_FALSE(RedisHandler::getInstance().getRedis()->exists("attached_topic:missing_id")) << "Attaching created missing key";
+}
+
+TEST_F(TestCacheMonitor, CheckAsyncOperations)
+{
+    TopicManager::getInstance().createTopic("async_topic");
+    auto cache_int = std::make_shared<CacheInt>("int_id", "async_topic", 1);
+    auto cache_list = std::make_shared<CacheList>("list_id", "async_topic", std::list<std::string>{"a"});
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    auto int_write = cache_int->setValueAsync(2);
+    auto list_write = cache_list->rpushAsync("b");
+    int_write.get();
+    list_write.get();
+    ASSERT_EQ("2", *RedisHandler::getInstance().getRedis()->get("async_topic:int_id")) << "Asynchronous set is not correct";
+    ASSERT_EQ(2, RedisHandler::getInstance().getRedis()->llen("async_topic:list_id")) << "Asynchronous rpush is not correct";
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_FALSE(cache_int->isChanged()) << "Echo of asynchronous write was not suppressed";
+
+    RedisHandler::getInstance().getRedis()->set("async_topic:int_id", "3");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    auto int_read = cache_int->getValueAsync();
+    ASSERT_EQ(3, std::any_cast<int>(int_read.get())) << "Asynchronous get is not correct";
+    ASSERT_FALSE(cache_int->isChanged()) << "Value is still changed after asynchronous get";
+}
+
+// Coroutines resume on the event loop thread of redis-plus-plus, so they must not block, and they share ownership
+// of everything they touch, so a test failing on timeout does not leave them with dangling references.
+DetachedCoroutine runAwaitableWrites(std::shared_ptr<CacheInt> cache_int, std::shared_ptr<CacheList> cache_list, std::shared_ptr<std::promise<void>> done)
+{
+    co_await cache_int->setValueAwait(2);
+    co_await cache_list->rpushAwait("b");
+    done->set_value();
+}
+
+DetachedCoroutine runAwaitableFetch(std::shared_ptr<CacheInt> cache_int, std::shared_ptr<std::promise<int>> result)
+{
+    std::any value = co_await cache_int->fetchAwait();
+    result->set_value(std::any_cast<int>(value));
+}
+
+TEST_F(TestCacheMonitor, CheckAwaitableOperations)
+{
+    TopicManager::getInstance().createTopic("coroutine_topic");
+    auto cache_int = std::make_shared<CacheInt>("int_id", "coroutine_topic", 1);
+    auto cache_list = std::make_shared<CacheList>("list_id", "coroutine_topic", std::list<std::string>{"a"});
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    auto written = std::make_shared<std::promise<void>>();
+    auto write_done = written->get_future();
+    runAwaitableWrites(cache_int, cache_list, written);
+    ASSERT_EQ(std::future_status::ready, write_done.wait_for(std::chrono::seconds(1))) << "Coroutine was not resumed after writes";
+    ASSERT_EQ(2, RedisHandler::getInstance().getRedis()->llen("coroutine_topic:list_id")) << "Awaited rpush is not correct";
+
+    RedisHandler::getInstance().getRedis()->set("coroutine_topic:int_id", "3");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    auto result = std::make_shared<std::promise<int>>();
+    auto value = result->get_future();
+    runAwaitableFetch(cache_int, result);
+    ASSERT_EQ(std::future_status::ready, value.wait_for(std::chrono::seconds(1))) << "Coroutine was not resumed after fetch";
+    ASSERT_EQ(3, value.get()) << "Awaited fetch is not correct";
+}
+
+TEST_F(TestCacheMonitor, CheckWriteBatch)
+{
+    TopicManager::getInstance().createTopic("batch_topic");
+    TopicManager::getInstance().createTopic("another_batch_topic");
+    CacheInt cache_int("int_id", "batch_topic", 1);
+    CacheList cache_list("list_id", "batch_topic", std::list<std::string>{"a"});
+    CacheMap cache_map("map_id", "another_batch_topic", std::map<std::string, std::string>{{"a", "1"}});
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    for (bool atomic : {false, true})
+    {
+        WriteBatch batch(atomic);
+        batch.setValue(cache_int, atomic ? 3 : 2);
+        batch.rpush(cache_list, atomic ? "c" : "b");
+        batch.addKey(cache_map, atomic ? "c" : "b", "2");
+        ASSERT_EQ(atomic ? 2 : 1, cache_int.toInt()) << "Local copy was updated before commit";
+        batch.commit();
+        ASSERT_TRUE(batch.empty()) << "Batch is not empty after commit";
+    }
+    ASSERT_EQ(3, cache_int.toInt()) << "Local int after commit is not correct";
+    ASSERT_EQ((std::list<std::string>{"a", "b", "c"}), cache_list.toList()) << "Local list after commit is not correct";
+    ASSERT_EQ("3", *RedisHandler::getInstance().getRedis()->get("batch_topic:int_id")) << "Int in Redis after commit is not correct";
+    ASSERT_EQ(3, RedisHandler::getInstance().getRedis()->llen("batch_topic:list_id")) << "List in Redis after commit is not correct";
+    ASSERT_EQ(3, cache_map.size()) << "Local map after commit is not correct";
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_FALSE(cache_int.isChanged()) << "Echo of batch write was not suppressed";
+}
+
+TEST_F(TestCacheMonitor, CheckContainerDeltaSync)
+{
+    TopicManager::getInstance().createTopic("delta_topic");
+    CacheList cache_list("list_id", "delta_topic", std::list<std::string>{"a", "b"});
+    CacheMap cache_map("map_id", "delta_topic", std::map<std::string, std::string>{{"a", "1"}, {"b", "2"}});
+    CacheSet cache_set("set_id", "delta_topic", std::set<std::string>{"a", "b"});
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    cache_list.setValue({"c"});
+    cache_map.setValue({{"b", "3"}, {"c", "4"}});
+    cache_set.setValue({"b", "c"});
+
+    std::list<std::string> list;
+    RedisHandler::getInstance().getRedis()->lrange("delta_topic:list_id", 0, -1, std::back_inserter(list));
+    ASSERT_EQ(std::list<std::string>{"c"}, list) << "List in Redis was not replaced";
+    std::map<std::string, std::string> map;
+    RedisHandler::getInstance().getRedis()->hgetall("delta_topic:map_id", std::inserter(map, map.begin()));
+    ASSERT_EQ((std::map<std::string, std::string>{{"b", "3"}, {"c", "4"}}), map) << "Map in Redis is not correct";
+    std::set<std::string> set;
+    RedisHandler::getInstance().getRedis()->smembers("delta_topic:set_id", std::inserter(set, set.begin()));
+    ASSERT_EQ((std::set<std::string>{"b", "c"}), set) << "Set in Redis is not correct";
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    // Echoes of own delta writes must not force a full fetch.
+    ASSERT_FALSE(cache_list.isChanged()) << "List is marked as changed by its own write";
+    ASSERT_FALSE(cache_map.isChanged()) << "Map is marked as changed by its own delta write";
+    ASSERT_FALSE(cache_set.isChanged()) << "Set is marked as changed by its own delta write";
+    ASSERT_EQ((std::map<std::string, std::string>{{"b", "3"}, {"c", "4"}}), cache_map.toMap()) << "Local map is not correct";
+    ASSERT_EQ((std::set<std::string>{"b", "c"}), cache_set.toSet()) << "Local set is not correct";
+
+    // Removing every field deletes the key, which is an echo as well.
+    cache_list.setValue({});
+    cache_map.setValue({{"d", "5"}});
+    cache_set.setValue({"d"});
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_FALSE(cache_list.isChanged()) << "List is marked as changed by its own clearing write";
+    ASSERT_FALSE(cache_map.isChanged()) << "Map is marked as changed by its own replacing write";
+    ASSERT_FALSE(cache_set.isChanged()) << "Set is marked as changed by its own replacing write";
+
+    RedisHandler::getInstance().getRedis()->hset("delta_topic:map_id", "e", "6");
+    RedisHandler::getInstance().getRedis()->sadd("delta_topic:set_id", "e");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_TRUE(cache_map.isChanged()) << "External map change after delta write is not noticed";
+    ASSERT_TRUE(cache_set.isChanged()) << "External set change after delta write is not noticed";
+}
+
+/**
+ * @brief List which can announce an own write without making it, to make a foreign change arrive in place of own echo.
+ */
+struct EchoingList : CacheList{
+    using CacheList::CacheList;
+    using CacheList::expectEcho_;
+};
+
+TEST_F(TestCacheMonitor, CheckForeignChangeTakenAsEcho)
+{
+    TopicManager::getInstance().createTopic("echo_topic");
+    EchoingList cache_list("list_id", "echo_topic", std::list<std::string>{"a", "b", "c"});
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_FALSE(cache_list.isChanged()) << "List is marked as changed by its own write";
+
+    // Foreign LSET arrives before the echo of own write and is consumed instead of it, the RPUSH is then recorded.
+    cache_list.expectEcho_();
+    RedisHandler::getInstance().getRedis()->lset("echo_topic:list_id", 1, "x");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    RedisHandler::getInstance().getRedis()->rpush("echo_topic:list_id", "d");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_TRUE(cache_list.isChanged()) << "Push after consumed echo is not noticed";
+    ASSERT_EQ((std::list<std::string>{"a", "x", "c", "d"}), cache_list.toList()) << "Change in the middle of the list is lost by delta fetch";
+}
+
+TEST_F(TestCacheMonitor, CheckAtomicNumericOperations)
+{
+    TopicManager::getInstance().createTopic("numeric_topic");
+    CacheInt cache_int("int_id", "numeric_topic", 10);
+    CacheFloat cache_float("float_id", "numeric_topic", 1.5f);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    ASSERT_EQ(11, cache_int.increment()) << "Incremented int is not correct";
+    RedisHandler::getInstance().getRedis()->incrby("numeric_topic:int_id", 5);
+    ASSERT_EQ(21, cache_int.add(5)) << "Concurrent increment was lost";
+    ASSERT_EQ(19, cache_int.decrement(2)) << "Decremented int is not correct";
+    ASSERT_EQ(2.5f, cache_float.add(1.0f)) << "Incremented float is not correct";
+    ASSERT_EQ(2.0f, cache_float.decrement(0.5f)) << "Decremented float is not correct";
+    CacheFloat small_float("small_float_id", "numeric_topic", 0.0f);
+    ASSERT_EQ(1e-7f, small_float.add(1e-7f)) << "Increment below six decimals is lost";
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_FALSE(cache_float.isChanged()) << "Echo of increment was not suppressed";
+    ASSERT_EQ(19, cache_int.toInt()) << "Local int is not correct";
+    ASSERT_EQ("19", *RedisHandler::getInstance().getRedis()->get("numeric_topic:int_id")) << "Int in Redis is not correct";
+
+    RedisHandler::getInstance().getRedis()->set("numeric_topic:int_id", std::to_string(std::numeric_limits<int>::max()));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_THROW(cache_int.increment(), std::out_of_range) << "Increment past the range of int is not rejected";
+    ASSERT_TRUE(cache_int.isChanged()) << "Int is marked as fetched after out of range increment";
+}
+
+TEST_F(TestCacheMonitor, CheckEventAwareInvalidation)
+{
+    TopicManager::getInstance().createTopic("event_topic");
+    auto cache_list = std::make_shared<CacheList>("list_id", "event_topic", std::list<std::string>{"a", "b"});
+    auto cache_string = std::make_shared<CacheString>("string_id", "event_topic", "test_value");
+    auto redis = RedisHandler::getInstance().getRedis();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    std::vector<std::string> pushed = {"c", "d"};
+    redis->rpush("event_topic:list_id", pushed.begin(), pushed.end());
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_EQ((std::list<std::string>{"a", "b", "c", "d"}), cache_list->toList()) << "List after external RPUSH is not correct";
+
+    redis->lpush("event_topic:list_id", "z");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_EQ((std::list<std::string>{"z", "a", "b", "c", "d"}), cache_list->toList()) << "List after external LPUSH is not correct";
+
+    redis->rpop("event_topic:list_id");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_EQ((std::list<std::string>{"z", "a", "b", "c"}), cache_list->toList()) << "List after external RPOP is not correct";
+
+    redis->lpop("event_topic:list_id");
+    redis->rpush("event_topic:list_id", "e");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_EQ((std::list<std::string>{"a", "b", "c", "e"}), cache_list->toList()) << "List after mixed external changes is not correct";
+
+    redis->del("event_topic:list_id");
+    redis->del("event_topic:string_id");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_TRUE(cache_list->empty()) << "List is not empty after external DEL";
+    ASSERT_EQ("", cache_string->toString()) << "String is not empty after external DEL";
+}
+
+TEST_F(TestCacheMonitor, CheckKeyspaceEventsAreOnlyWidened)
+{
+    auto redis = RedisHandler::getInstance().getRedis();
+    // Flags of another process sharing the Redis.
+    redis->command("config", "set", "notify-keyspace-events", "Kgxez");
+    TopicManager::getInstance().createTopic("flags_topic");
+    {
+        CacheList cache_list("list_id", "flags_topic", std::list<std::string>{"a"});
+        CacheSet cache_set("set_id", "flags_topic", std::set<std::string>{"a"});
+    }
+    auto flags = redis->command<std::vector<std::string>>("config", "get", "notify-keyspace-events");
+    ASSERT_EQ(2, flags.size()) << "Keyspace events flags are not returned";
+    ASSERT_NE(std::string::npos, flags[1].find('z')) << "Flag of another process is removed";
+    ASSERT_NE(std::string::npos, flags[1].find('l')) << "List events are not enabled";
+    ASSERT_NE(std::string::npos, flags[1].find('s')) << "Set events are removed after the last set is unregistered";
+}
+
+TEST_F(TestCacheMonitor, CheckInvalidationKeyParsing)
+{
+    KeyspaceChannel channel;
+    ASSERT_TRUE(KeyspaceChannel::parseKey("tracked_topic:test_id", channel)) << "Key with ID is not parsed";
+    ASSERT_EQ("tracked_topic", channel.topic_path) << "Topic path of key is not correct";
+    ASSERT_EQ("test_id", channel.id) << "ID of key is not correct";
+
+    ASSERT_TRUE(KeyspaceChannel::parse("__keyspace@0__:tracked_topic:test_id", channel)) << "Keyspace channel is not parsed";
+    ASSERT_EQ("tracked_topic", channel.topic_path) << "Topic path of channel is not correct";
+    ASSERT_EQ("test_id", channel.id) << "ID of channel is not correct";
+
+    ASSERT_TRUE(KeyspaceChannel::parseKey("tracked_topic", channel)) << "Key without ID is not parsed";
+    ASSERT_TRUE(channel.id.empty()) << "ID of key without ID is not empty";
+}
+
+TEST_F(TestCacheMonitor, CheckWriteBehindQueue)
+{
+    TopicManager::getInstance().createTopic("queue_topic");
+    auto redis = RedisHandler::getInstance().getRedis();
+    auto cache_value = std::make_shared<CacheInt>("test_id", "queue_topic", 0);
+    {
+        // Interval is long enough that only explicit flushes and the destructor write.
+        WriteBehindQueue queue(redis, nullptr, std::chrono::hours(1), 1000);
+        redis->command("config", "resetstat");
+        for (int i = 1; i <= 100; ++i)
+            queue.enqueue(cache_value.get(), {"SET", "queue_topic:test_id", std::to_string(i)});
+        ASSERT_EQ("0", *redis->get("queue_topic:test_id")) << "Queued writes are written before flush";
+
+        queue.flush();
+        ASSERT_EQ("100", *redis->get("queue_topic:test_id")) << "Value after flush is not correct";
+        ASSERT_NE(std::string::npos, redis->info("commandstats").find("cmdstat_set:calls=1,")) << "Queued writes are not coalesced into a single SET";
+
+        queue.enqueue(cache_value.get(), {"SET", "queue_topic:test_id", "101"});
+    }
+    ASSERT_EQ("101", *redis->get("queue_topic:test_id")) << "Pending write is not flushed on destruction";
+}
+
+/**
+ * @brief Get the options of a dedicated connection to the configured Redis, used by a standalone `ChangeLog`.
+ */
+static sw::redis::ConnectionOptions changeLogOptions()
+{
+    sw::redis::ConnectionOptions options;
+    options.host = RedisHandler::getConfig().host;
+    options.port = RedisHandler::getConfig().port;
+    options.db = RedisHandler::getConfig().db;
+    return options;
+}
+
+TEST_F(TestCacheMonitor, CheckChangeLogAppend)
+{
+    TopicManager::getInstance().createTopic("log_topic");
+    auto first_value = std::make_shared<CacheString>("first_id", "log_topic", "first_value");
+    auto second_value = std::make_shared<CacheString>("second_id", "log_topic", "second_value");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ChangeLog change_log(RedisHandler::getInstance().getRedis(), changeLogOptions(), 1000, std::chrono::milliseconds(100));
+    change_log.subscribe("log_topic");
+
+    change_log.append("log_topic", "first_id");
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    ASSERT_EQ(std::set<std::string>{"first_id"}, TopicManager::getInstance().getTopic("log_topic")->check_changed_parameters()) << "Changed parameters after append are not correct";
+    ASSERT_FALSE(second_value->isChanged()) << "Value which was not appended is marked as changed";
+
+    change_log.unsubscribe("log_topic");
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    change_log.append("log_topic", "second_id");
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    ASSERT_FALSE(second_value->isChanged()) << "Append is read after unsubscribing";
+}
+
+TEST_F(TestCacheMonitor, CheckChangeLogResume)
+{
+    TopicManager::getInstance().createTopic("resumed_topic");
+    auto redis = RedisHandler::getInstance().getRedis();
+    auto first_value = std::make_shared<CacheString>("first_id", "resumed_topic", "first_value");
+    auto second_value = std::make_shared<CacheString>("second_id", "resumed_topic", "second_value");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ChangeLog change_log(redis, changeLogOptions(), 1000, std::chrono::milliseconds(1000));
+    change_log.subscribe("resumed_topic");
+    change_log.append("resumed_topic", "second_id");
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    ASSERT_TRUE(second_value->isChanged()) << "Append before the failure is not read";
+    second_value->toString();
+    std::uint64_t epoch = TopicManager::getInstance().getTopic("resumed_topic")->getEpoch();
+
+    // Reader is blocked in XREAD, killing its connection makes the read fail.
+    std::string clients = redis->command<std::string>("CLIENT", "LIST");
+    std::size_t command = clients.find("cmd=xread");
+    ASSERT_NE(std::string::npos, command) << "Reading connection is not found";
+    std::size_t reader = clients.rfind("id=", command);
+    std::string reader_id = clients.substr(reader + 3, clients.find(' ', reader) - reader - 3);
+    redis->command<long long>("CLIENT", "KILL", "ID", reader_id);
+    change_log.append("resumed_topic", "first_id");
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    ASSERT_TRUE(first_value->isChanged()) << "Append during the failure is not read after reconnecting";
+    ASSERT_FALSE(second_value->isChanged()) << "Value read before the failure is marked as changed again";
+    ASSERT_EQ(epoch, TopicManager::getInstance().getTopic("resumed_topic")->getEpoch()) << "Whole topic is reloaded after the failure";
+}
+
+TEST_F(TestCacheMonitor, CheckChangeLogTrimming)
+{
+    TopicManager::getInstance().createTopic("trimmed_topic");
+    auto redis = RedisHandler::getInstance().getRedis();
+    auto first_value = std::make_shared<CacheString>("first_id", "trimmed_topic", "first_value");
+    auto second_value = std::make_shared<CacheString>("second_id", "trimmed_topic", "second_value");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ChangeLog change_log(redis, changeLogOptions(), 2, std::chrono::milliseconds(100));
+    change_log.subscribe("trimmed_topic");
+    change_log.append("trimmed_topic", "first_id");
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    first_value->toString();
+    std::uint64_t epoch = TopicManager::getInstance().getTopic("trimmed_topic")->getEpoch();
+
+    // Stream replaced by a string makes reading fail until entries after the offset are trimmed away.
+    std::string key = ChangeLog::streamKey("trimmed_topic");
+    redis->set(key, "broken");
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    {
+        auto transaction = redis->transaction();
+        transaction.del(key);
+        for (const char* id : {"second_id", "second_id", "second_id"})
+            change_log.queueAppend(transaction, "trimmed_topic", id);
+        transaction.command("XTRIM", key, "MAXLEN", "2");
+        transaction.exec();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    ASSERT_LT(epoch, TopicManager::getInstance().getTopic("trimmed_topic")->getEpoch()) << "Trimmed entries did not bump the epoch of the topic";
+    ASSERT_TRUE(first_value->isChanged()) << "Value is not marked as changed after its entries were trimmed";
+}
+
+TEST_F(TestCacheMonitor, CheckEpochInvalidation)
+{
+    TopicManager::getInstance().createTopic("epoch_topic");
+    TopicManager::getInstance().createTopic("other_epoch_topic");
+    auto cache_string = std::make_shared<CacheString>("test_string", "epoch_topic", "test_value");
+    auto cache_list = std::make_shared<CacheList>("test_list", "epoch_topic", std::list<std::string>{"first"});
+    auto other_value = std::make_shared<CacheInt>("test_id", "other_epoch_topic", 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_FALSE(cache_string->isChanged()) << "Value is marked as changed without external write";
+
+    TopicManager::getInstance().markAllChanged("epoch_topic");
+    ASSERT_TRUE(cache_string->isChanged()) << "String is not marked as changed after topic epoch bump";
+    ASSERT_TRUE(cache_list->isChanged()) << "List is not marked as changed after topic epoch bump";
+    ASSERT_FALSE(other_value->isChanged()) << "Value of other topic is marked as changed after topic epoch bump";
+    ASSERT_EQ(2, TopicManager::getInstance().getTopic("epoch_topic")->check_changed_parameters().size()) << "Changed parameters after topic epoch bump are not correct";
+
+    TopicManager::getInstance().refresh();
+    ASSERT_FALSE(cache_string->isChanged()) << "String is still marked as changed after refresh";
+    ASSERT_FALSE(cache_list->isChanged()) << "List is still marked as changed after refresh";
+    ASSERT_EQ("test_value", cache_string->toString()) << "String after refresh is not correct";
+
+    TopicManager::getInstance().markAllChanged();
+    ASSERT_TRUE(other_value->isChanged()) << "Value is not marked as changed after global epoch bump";
+    ASSERT_EQ(1, other_value->toInt()) << "Value after global epoch bump is not correct";
+    ASSERT_FALSE(other_value->isChanged()) << "Value is still marked as changed after read";
+
+    // Epoch bump overrides the recorded deletion, so the batch fetch has to notice the key is missing.
+    RedisHandler::getInstance().getRedis()->del("epoch_topic:test_string");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    TopicManager::getInstance().markAllChanged("epoch_topic");
+    TopicManager::getInstance().refresh();
+    ASSERT_EQ("", cache_string->toString()) << "String deleted before epoch bump is not cleared by refresh";
+
+    RedisHandler::getInstance().getRedis()->del("other_epoch_topic:test_id");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    TopicManager::getInstance().markAllChanged();
+    ASSERT_EQ(0, other_value->toInt()) << "Value deleted before epoch bump is not cleared by read";
+}
+
+TEST_F(TestCacheMonitor, CheckSubscriberReconnect)
+{
+    TopicManager::getInstance().createTopic("reconnect_topic");
+    auto redis = RedisHandler::getInstance().getRedis();
+    auto cache_value = std::make_shared<CacheString>("test_id", "reconnect_topic", "test_value");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_FALSE(cache_value->isChanged()) << "String is marked as changed by its own write";
+    NotificationStats before = RedisHandler::getInstance().getNotificationStats();
+
+    redis->command<long long>("CLIENT", "KILL", "TYPE", "pubsub");
+    for (int i = 0; i < 50 && RedisHandler::getInstance().getNotificationStats().reconnects == before.reconnects; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_LT(before.reconnects, RedisHandler::getInstance().getNotificationStats().reconnects) << "Subscriber was not reconnected";
+    // Notifications sent while disconnected are lost, so every value is stale.
+    ASSERT_TRUE(cache_value->isChanged()) << "String is not stale after reconnect";
+    ASSERT_EQ("test_value", cache_value->toString()) << "String after reconnect is not correct";
+
+    redis->set("reconnect_topic:test_id", "new_value");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_TRUE(cache_value->isChanged()) << "Subscription was not restored after reconnect";
+    ASSERT_EQ("new_value", cache_value->toString()) << "String after restored subscription is not correct";
+
+    // Subscription requested after the reconnect is confirmed, so counting of acknowledgements was restored as well.
+    TopicManager::getInstance().createTopic("new_reconnect_topic");
+    auto new_value = std::make_shared<CacheString>("test_id", "new_reconnect_topic", "test_value");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    redis->set("new_reconnect_topic:test_id", "new_value");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_TRUE(new_value->isChanged()) << "Topic created after reconnect is not subscribed";
+}
+
+TEST_F(TestCacheMonitor, CheckReadViews)
+{
+    TopicManager::getInstance().createTopic("view_topic");
+    auto cache_map = std::make_shared<CacheMap>("test_map", "view_topic", std::map<std::string, std::string>{{"key", "value"}});
+    auto cache_int = std::make_shared<CacheInt>("test_int", "view_topic", 7);
+    ASSERT_EQ(cache_map->toMap(), cache_map->view()) << "Map view is not correct";
+    ASSERT_EQ(7, cache_int->view()) << "Int view is not correct";
+
+    RedisHandler::getInstance().getRedis()->hset("view_topic:test_map", "other_key", "other_value");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    const std::map<std::string, std::string>& view = cache_map->view();
+    ASSERT_EQ(2, view.size()) << "Map view after external write is not correct";
+    ASSERT_EQ("other_value", view.at("other_key")) << "Map view after external write is not correct";
+}
+
+TEST_F(TestCacheMonitor, CheckCustomCodec)
+{
+    TopicManager::getInstance().createTopic("codec_topic");
+    auto cache_point = std::make_shared<CacheValue<TestPoint, TestPointCodec>>("test_id", "codec_topic", TestPoint{1, 2});
+    ASSERT_EQ("1,2", *RedisHandler::getInstance().getRedis()->get("codec_topic:test_id")) << "Encoded point is not correct";
+
+    RedisHandler::getInstance().getRedis()->set("codec_topic:test_id", "3,4");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_EQ(3, cache_point->view().x) << "Decoded point is not correct";
+    ASSERT_EQ(4, cache_point->view().y) << "Decoded point is not correct";
+
+    WriteBatch batch;
+    batch.setValue(*cache_point, TestPoint{5, 6});
+    batch.commit();
+    ASSERT_EQ("5,6", *RedisHandler::getInstance().getRedis()->get("codec_topic:test_id")) << "Point written by batch is not correct";
+    ASSERT_EQ(5, cache_point->view().x) << "Point after batch is not correct";
+}
+
+TEST_F(TestCacheMonitor, CheckNumericEncoding)
+{
+    TopicManager::getInstance().createTopic("encoding_topic");
+    auto cache_float = std::make_shared<CacheFloat>("test_float", "encoding_topic", 0.1f);
+    ASSERT_EQ("0.1", *RedisHandler::getInstance().getRedis()->get("encoding_topic:test_float")) << "Float is not encoded as shortest text";
+
+    cache_float->setValue(1.2345678e-7f);
+    RedisHandler::getInstance().getRedis()->set("encoding_topic:test_float", *RedisHandler::getInstance().getRedis()->get("encoding_topic:test_float"));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_EQ(1.2345678e-7f, cache_float->view()) << "Small float does not survive encoding";
+
+    auto cache_int = std::make_shared<CacheInt>("test_int", "encoding_topic", -2147483647 - 1);
+    ASSERT_EQ("-2147483648", *RedisHandler::getInstance().getRedis()->get("encoding_topic:test_int")) << "Integer encoding is not correct";
+    ASSERT_THROW(DefaultCodec<int>::decode("12abc"), std::invalid_argument) << "Invalid integer is decoded";
+
+    auto binary_float = std::make_shared<CacheValue<float, BinaryCodec<float>>>("test_binary", "encoding_topic", 3.14159f);
+    ASSERT_EQ(sizeof(float), RedisHandler::getInstance().getRedis()->get("encoding_topic:test_binary")->size()) << "Binary float size is not correct";
+    RedisHandler::getInstance().getRedis()->set("encoding_topic:test_binary", BinaryCodec<float>::encode(2.5f));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_EQ(2.5f, binary_float->view()) << "Binary float after external write is not correct";
+}
+
+TEST_F(TestCacheMonitor, CheckCompression)
+{
+    TopicManager::getInstance().createTopic("compression_topic");
+    std::string document;
+    for (int i = 0; i < 1000; ++i)
+        document += "{\"field\": \"value\", \"index\": " + std::to_string(i % 10) + "}";
+    auto cache_value = std::make_shared<CacheString>("test_id", "compression_topic", "short");
+    cache_value->setCompressionThreshold(1024);
+    cache_value->setValue("short");
+    ASSERT_EQ("short", *RedisHandler::getInstance().getRedis()->get("compression_topic:test_id")) << "Small value is compressed";
+
+    cache_value->setValue(document);
+    std::string stored = *RedisHandler::getInstance().getRedis()->get("compression_topic:test_id");
+    ASSERT_LT(stored.size(), document.size()) << "Large value is not compressed";
+    CompressionStats stats = cache_value->getCompressionStats();
+    ASSERT_EQ(1, stats.compressed_writes) << "Compressed writes are not counted";
+    ASSERT_EQ(document.size(), stats.raw_bytes) << "Raw bytes are not correct";
+    ASSERT_EQ(stored.size(), stats.compressed_bytes) << "Compressed bytes are not correct";
+
+    auto reader = std::make_shared<CacheString>("reader_id", "compression_topic", AttachTag());
+    RedisHandler::getInstance().getRedis()->set("compression_topic:reader_id", stored);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_EQ(document, reader->view()) << "Compressed value is not decompressed by reader without threshold";
+    ASSERT_EQ(1, reader->getCompressionStats().decompressed_reads) << "Decompressed reads are not counted";
+}
+
+TEST_F(TestCacheMonitor, CheckStringRanges)
+{
+    TopicManager::getInstance().createTopic("range_topic");
+    auto redis = RedisHandler::getInstance().getRedis();
+    auto cache_value = std::make_shared<CacheString>("test_id", "range_topic", "hello");
+
+    ASSERT_EQ(11, cache_value->append(" world")) << "Length after append is not correct";
+    ASSERT_EQ("hello world", cache_value->view()) << "Local string after append is not correct";
+    ASSERT_EQ("hello world", *redis->get("range_topic:test_id")) << "String in Redis after append is not correct";
+
+    ASSERT_EQ(11, cache_value->setRange(6, "there")) << "Length after setRange is not correct";
+    ASSERT_EQ(13, cache_value->setRange(11, "!!")) << "Length after setRange past the end is not correct";
+    ASSERT_EQ("hello there!!", cache_value->view()) << "Local string after setRange is not correct";
+    ASSERT_EQ("hello there!!", *redis->get("range_topic:test_id")) << "String in Redis after setRange is not correct";
+
+    ASSERT_EQ("hello", cache_value->getRange(0, 4)) << "Range from the start is not correct";
+    ASSERT_EQ("there!!", cache_value->getRange(-7, -1)) << "Range from the end is not correct";
+    ASSERT_EQ("!", cache_value->getRange(12, 100)) << "Range past the end is not correct";
+    ASSERT_EQ("", cache_value->getRange(5, 2)) << "Empty range is not correct";
+
+    redis->append("range_topic:test_id", " and");
+    redis->append("range_topic:test_id", " more");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_EQ("hello there!! and more", cache_value->view()) << "String after external APPEND is not correct";
+
+    // Write of another process in between is detected by the length in the reply of APPEND.
+    redis->append("range_topic:test_id", "?");
+    ASSERT_EQ(24, cache_value->append(".")) << "Length after concurrent append is not correct";
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_EQ("hello there!! and more?.", cache_value->view()) << "String after concurrent append is not correct";
+
+    cache_value->setCompressionThreshold(1024);
+    ASSERT_THROW(cache_value->append("x"), std::logic_error) << "Append to compressed value is not rejected";
+
+    // Value compressed by another writer, while this one does not compress.
+    cache_value->setCompressionThreshold(0);
+    Compression compression(1);
+    std::string stored = compression.pack(std::string(2000, 'a'));
+    redis->set("range_topic:test_id", stored);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_THROW(cache_value->append("x"), std::logic_error) << "Append to value compressed by another writer is not rejected";
+    ASSERT_THROW(cache_value->setRange(0, "x"), std::logic_error) << "SetRange of value compressed by another writer is not rejected";
+    ASSERT_EQ(stored, *redis->get("range_topic:test_id")) << "Value compressed by another writer is modified";
+}
+
 int main()
 {
     ::testing::InitGoogleTest();
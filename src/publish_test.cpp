@@ -0,0 +1,134 @@
+#include <redis_handler.h>
+#include <topic_manager.h>
+#include <cache_value.h>
+#include <write_batch.h>
+#include <write_behind_queue.h>
+#include <topic.h>
+#include <thread>
+#include <chrono>
+#include <memory>
+#include <gtest/gtest.h>
+
+/**
+ * @brief Tests of `RedisConfig::publish_values`, which has to be configured before the first use of the library.
+ */
+class TestPublishedValues : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        RedisHandler::getInstance().getRedis()->command("FLUSHALL");
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+};
+
+/**
+ * @brief String which exposes its write command, so the test can write like another publishing process.
+ */
+struct PublishingString : CacheString{
+    using CacheString::CacheString;
+    using CacheString::writeCommand_;
+};
+
+/**
+ * @brief Check whether a command was called since the statistics were reset.
+ */
+static bool wasCalled(const std::string& command)
+{
+    return RedisHandler::getInstance().getRedis()->info("commandstats").find("cmdstat_" + command + ":") != std::string::npos;
+}
+
+TEST_F(TestPublishedValues, CheckPublishedValueIsApplied)
+{
+    TopicManager::getInstance().createTopic("published_topic");
+    auto redis = RedisHandler::getInstance().getRedis();
+    auto cache_value = std::make_shared<PublishingString>("test_id", "published_topic", "test_value");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_FALSE(cache_value->isChanged()) << "String is marked as changed by its own publishing write";
+
+    // Write of another process is the same script sent without expecting its echoes.
+    std::vector<std::string> command = cache_value->writeCommand_("new_value");
+    redis->command<void>(command.begin(), command.end());
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_TRUE(cache_value->isChanged()) << "Published write is not noticed";
+    redis->command("config", "resetstat");
+    ASSERT_EQ("new_value", cache_value->toString()) << "Published string is not correct";
+    ASSERT_FALSE(wasCalled("get")) << "Published value is fetched instead of applied";
+
+    // Write which does not publish, e.g. of another client, is only invalidated and has to be fetched.
+    redis->set("published_topic:test_id", "plain_value");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_TRUE(cache_value->isChanged()) << "Write without publishing is not noticed";
+    redis->command("config", "resetstat");
+    ASSERT_EQ("plain_value", cache_value->toString()) << "String after write without publishing is not correct";
+    ASSERT_TRUE(wasCalled("get")) << "Value written without publishing is not fetched";
+}
+
+TEST_F(TestPublishedValues, CheckRefreshAppliesPublishedValues)
+{
+    TopicManager::getInstance().createTopic("refreshed_topic");
+    auto redis = RedisHandler::getInstance().getRedis();
+    auto cache_value = std::make_shared<PublishingString>("test_id", "refreshed_topic", "test_value");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    std::vector<std::string> command = cache_value->writeCommand_("new_value");
+    redis->command<void>(command.begin(), command.end());
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    redis->command("config", "resetstat");
+    TopicManager::getInstance().getTopic("refreshed_topic")->refresh();
+    ASSERT_FALSE(wasCalled("mget") || wasCalled("get")) << "Refresh fetches a published value";
+    ASSERT_FALSE(cache_value->isChanged()) << "Published value is still changed after refresh";
+    ASSERT_EQ("new_value", cache_value->toString()) << "String after refresh is not correct";
+}
+
+TEST_F(TestPublishedValues, CheckOwnWritesAreEchoes)
+{
+    TopicManager::getInstance().createTopic("echo_topic");
+    auto redis = RedisHandler::getInstance().getRedis();
+    auto cache_value = std::make_shared<PublishingString>("test_id", "echo_topic", "test_value");
+    auto cache_int = std::make_shared<CacheInt>("int_id", "echo_topic", 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    // Every own write sends a keyspace notification and a message, both have to be taken as echoes.
+    cache_value->setValue("direct_value");
+    cache_int->setValue(1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_FALSE(cache_value->isChanged()) << "Direct write is not taken as an echo";
+    ASSERT_FALSE(cache_int->isChanged()) << "Direct write of int is not taken as an echo";
+
+    cache_value->setValueAsync("async_value").get();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_FALSE(cache_value->isChanged()) << "Asynchronous write is not taken as an echo";
+
+    WriteBatch batch;
+    batch.setValue(*cache_value, "batch_value");
+    batch.setValue(*cache_int, 2);
+    batch.commit();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_FALSE(cache_value->isChanged()) << "Batch write is not taken as an echo";
+    ASSERT_FALSE(cache_int->isChanged()) << "Batch write of int is not taken as an echo";
+
+    {
+        WriteBehindQueue queue(redis, nullptr, std::chrono::hours(1), 1000);
+        queue.enqueue(cache_value.get(), cache_value->writeCommand_("queued_value"));
+        queue.flush();
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_FALSE(cache_value->isChanged()) << "Write-behind write is not taken as an echo";
+    ASSERT_EQ("queued_value", *redis->get("echo_topic:test_id")) << "String in Redis is not correct";
+
+    // Echoes are all consumed, so the next foreign write is noticed.
+    redis->set("echo_topic:test_id", "foreign_value");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_TRUE(cache_value->isChanged()) << "Foreign write after own writes is not noticed";
+    ASSERT_EQ("foreign_value", cache_value->toString()) << "String after foreign write is not correct";
+}
+
+int main()
+{
+    RedisConfig config;
+    config.publish_values = true;
+    RedisHandler::configure(config);
+    ::testing::InitGoogleTest();
+    return RUN_ALL_TESTS();
+}
@@ -1,58 +1,601 @@
 #include <redis_handler.h>
 #include <topic_manager.h>
+#include <hiredis/hiredis.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
 #include <iostream>
 
+RedisConfig RedisHandler::config_;
+std::atomic<bool> RedisHandler::created_(false);
+
 RedisHandler::RedisHandler() : redis_(std::make_shared<sw::redis::Redis>(connection_options_())),
-                               sub_(redis_->subscriber()),
-                               stop_worker_(false)
+                               async_redis_(std::make_shared<sw::redis::AsyncRedis>(connection_options_())),
+                               sub_ctx_(nullptr),
+                               tracking_ctx_(nullptr),
+                               subscriber_id_(0),
+                               stop_worker_(false),
+                               wake_fd_(-1),
+                               subscription_requests_(0),
+                               subscription_acks_(0),
+                               worker_running_(true),
+                               stat_messages_(0),
+                               stat_batches_(0),
+                               stat_last_batch_size_(0),
+                               stat_max_batch_size_(0),
+                               stat_backlog_bytes_(0),
+                               stat_reconnects_(0)
 {
-    redis_->command("config", "set", "notify-keyspace-events", "KEA");
-    sub_.psubscribe("__keyspace@0__:*");
-    sub_.on_pmessage([](std::string pattern, std::string channel, std::string msg)
-                     {
-        std::istringstream msgstream(channel);
-        std::getline(msgstream, channel, ':');
-        std::string topic_path;
-        std::string value_id;
+    sw::redis::ConnectionOptions options = connection_options_();
+    updateKeyspaceEvents_();
+
+    sub_ctx_ = redisConnect(options.host.c_str(), options.port);
+    if (sub_ctx_ == nullptr || sub_ctx_->err)
+        throw std::runtime_error("Cannot connect subscriber to Redis: " + std::string(sub_ctx_ ? sub_ctx_->errstr : "allocation error"));
+    if (config_.invalidation_mode == InvalidationMode::Tracking)
+        connectTracking_();
+
+    wake_fd_ = eventfd(0, EFD_NONBLOCK);
+    if (wake_fd_ < 0)
+        throw std::runtime_error("Cannot create event file descriptor for subscriber worker");
 
-        std::getline(msgstream, topic_path, ':');
-        std::getline(msgstream, value_id, ':');
-        TopicManager::getInstance().addChangedParameter(topic_path, value_id); });
-    // TODO: replace this magic number with some config, same with connection_options_
-    worker_thread_ = std::thread(&RedisHandler::worker_, this, std::ref(sub_), 1, std::ref(stop_worker_));
+    if (config_.invalidation_mode == InvalidationMode::ChangeLog)
+        change_log_ = std::make_unique<ChangeLog>(redis_.get(), options, config_.change_log_max_length, config_.change_log_block);
+    if (config_.write_behind)
+        write_behind_ = std::make_unique<WriteBehindQueue>(redis_.get(), change_log_.get(), config_.write_behind_interval, config_.write_behind_batch_size);
+
+    batch_.reserve(config_.max_batch_size);
+    batch_replies_.reserve(config_.max_batch_size);
+    batch_group_.reserve(config_.max_batch_size);
+    worker_thread_ = std::thread(&RedisHandler::worker_, this);
 }
 
 RedisHandler::~RedisHandler()
 {
     stop_worker_ = true;
     worker_thread_.join();
+    for (void* reply : batch_replies_)
+        freeReplyObject(reply);
+    redisFree(sub_ctx_);
+    redisFree(tracking_ctx_);
+    close(wake_fd_);
+}
+
+void RedisHandler::configure(const RedisConfig& config)
+{
+    if (created_)
+        throw std::logic_error("RedisHandler has to be configured before its first use");
+    config_ = config;
 }
 
 RedisHandler &RedisHandler::getInstance()
 {
+    created_ = true;
     static RedisHandler instance_;
     return instance_;
 }
 
+const RedisConfig &RedisHandler::getConfig()
+{
+    return config_;
+}
+
 sw::redis::Redis *RedisHandler::getRedis()
 {
     return redis_.get();
 }
 
+sw::redis::AsyncRedis *RedisHandler::getAsyncRedis()
+{
+    return async_redis_.get();
+}
+
+ChangeLog *RedisHandler::getChangeLog()
+{
+    return change_log_.get();
+}
+
+void RedisHandler::resume(std::coroutine_handle<> handle)
+{
+    if (config_.executor)
+        config_.executor(handle);
+    else
+        handle.resume();
+}
+
+WriteBehindQueue *RedisHandler::getWriteBehind()
+{
+    return write_behind_.get();
+}
+
+void RedisHandler::flush()
+{
+    if (write_behind_)
+        write_behind_->flush();
+}
+
+NotificationStats RedisHandler::getNotificationStats()
+{
+    NotificationStats stats;
+    stats.messages = stat_messages_.load(std::memory_order_relaxed);
+    stats.batches = stat_batches_.load(std::memory_order_relaxed);
+    stats.last_batch_size = stat_last_batch_size_.load(std::memory_order_relaxed);
+    stats.max_batch_size = stat_max_batch_size_.load(std::memory_order_relaxed);
+    stats.backlog_bytes = stat_backlog_bytes_.load(std::memory_order_relaxed);
+    stats.reconnects = stat_reconnects_.load(std::memory_order_relaxed);
+    return stats;
+}
+
 sw::redis::ConnectionOptions RedisHandler::connection_options_()
 {
     sw::redis::ConnectionOptions connection_options;
-    connection_options.host = "127.0.0.1";
-    connection_options.port = 6379;
-    connection_options.db = 0;
+    connection_options.host = config_.host;
+    connection_options.port = config_.port;
+    connection_options.db = config_.db;
     return connection_options;
 }
 
-void RedisHandler::worker_(sw::redis::Subscriber &sub_ptr, int interval, const std::atomic<bool> &stop_worker_)
+void RedisHandler::worker_()
 {
+    int timeout = config_.idle_strategy == IdleStrategy::Blocking ? static_cast<int>(config_.blocking_timeout.count()) : 0;
+    int idle_rounds = 0;
     while (!stop_worker_)
     {
-        sub_ptr.consume();
-        std::this_thread::sleep_for(std::chrono::microseconds(interval));
+        pollfd fds[2] = {{sub_ctx_->fd, POLLIN, 0}, {wake_fd_, POLLIN, 0}};
+        if (poll(fds, 2, timeout) <= 0)
+        {
+            if (config_.idle_strategy == IdleStrategy::Backoff)
+                backoff_(idle_rounds++);
+            continue;
+        }
+        idle_rounds = 0;
+
+        bool connected = true;
+        if (fds[1].revents & POLLIN)
+            connected = sendPendingSubscriptions_();
+        if (connected && (fds[0].revents & POLLIN))
+            connected = drainNotifications_();
+        // Closed or broken socket is reported without POLLIN, and would be reported again by every poll.
+        if (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL))
+            connected = false;
+        if (!connected)
+        {
+            std::cerr << "Subscriber connection failed: " << sub_ctx_->errstr << std::endl;
+            reconnectSubscriber_();
+        }
+    }
+
+    std::lock_guard lock(subscription_mutex_);
+    worker_running_ = false;
+    subscription_cv_.notify_all();
+}
+
+void RedisHandler::reconnectSubscriber_()
+{
+    // Notifications read before the failure are still valid.
+    applyBatch_();
+    int failures = 0;
+    while (!stop_worker_ && !connectSubscriber_())
+    {
+        std::chrono::milliseconds delay = config_.reconnect_delay * (1 << std::min(failures++, 16));
+        std::this_thread::sleep_for(std::min(delay, config_.max_reconnect_delay));
+    }
+    if (stop_worker_)
+        return;
+
+    stat_reconnects_.fetch_add(1, std::memory_order_relaxed);
+    // Server may have been restarted with default flags, or another process may have overwritten them.
+    if (config_.invalidation_mode == InvalidationMode::KeyspaceEvents)
+    {
+        try
+        {
+            verifyKeyspaceEvents_();
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Cannot verify keyspace events: " << e.what() << std::endl;
+        }
+    }
+    applyBatch_();
+    // Notifications sent while disconnected are lost, so every local copy may be stale. Change log reader reads them itself.
+    if (config_.invalidation_mode != InvalidationMode::ChangeLog)
+        TopicManager::getInstance().markAllChanged();
+}
+
+bool RedisHandler::connectSubscriber_()
+{
+    redisFree(sub_ctx_);
+    sw::redis::ConnectionOptions options = connection_options_();
+    sub_ctx_ = redisConnect(options.host.c_str(), options.port);
+    if (sub_ctx_ == nullptr || sub_ctx_->err)
+    {
+        std::cerr << "Cannot reconnect subscriber to Redis: " << (sub_ctx_ ? sub_ctx_->errstr : "allocation error") << std::endl;
+        return false;
+    }
+
+    if (config_.invalidation_mode == InvalidationMode::Tracking)
+    {
+        try
+        {
+            // Tracking redirects to the client ID of the subscriber, which is new, so it is enabled again from scratch.
+            std::lock_guard lock(tracking_mutex_);
+            redisFree(tracking_ctx_);
+            tracking_ctx_ = nullptr;
+            connectTracking_();
+            for (const std::string& prefix : tracking_prefixes_)
+                enableTracking_(prefix);
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << e.what() << std::endl;
+            return false;
+        }
+    }
+
+    std::vector<std::pair<std::string, std::string>> subscriptions;
+    std::uint64_t request;
+    {
+        // Requests not sent yet are already part of the active subscriptions, they are confirmed by restoring them.
+        std::lock_guard lock(subscription_mutex_);
+        pending_subscriptions_.clear();
+        for (const auto& [pattern, command] : subscriptions_)
+            subscriptions.emplace_back(command, pattern);
+        request = subscription_requests_;
+        subscription_acks_ = request - subscriptions.size();
+    }
+    for (const auto& [command, pattern] : subscriptions)
+        redisAppendCommand(sub_ctx_, "%b %b", command.data(), command.size(), pattern.data(), pattern.size());
+
+    while (true)
+    {
+        {
+            std::lock_guard lock(subscription_mutex_);
+            if (subscription_acks_ >= request)
+                return true;
+        }
+        void* reply = nullptr;
+        if (redisGetReply(sub_ctx_, &reply) != REDIS_OK)
+            return false;
+        collectNotification_(reply);
+    }
+}
+
+void RedisHandler::backoff_(int idle_rounds)
+{
+    // Spin a few rounds first, then give up the time slice, then sleep exponentially longer.
+    if (idle_rounds < 16)
+        return;
+    if (idle_rounds < 32)
+    {
+        std::this_thread::yield();
+        return;
+    }
+    int exponent = std::min(idle_rounds - 32, 20);
+    std::chrono::microseconds sleep = std::min(std::chrono::microseconds(1 << exponent), config_.max_backoff);
+    std::this_thread::sleep_for(sleep);
+}
+
+bool RedisHandler::sendPendingSubscriptions_()
+{
+    std::uint64_t value;
+    if (read(wake_fd_, &value, sizeof(value)) < 0 && errno != EAGAIN)
+        return false;
+
+    std::vector<std::pair<std::string, std::string>> subscriptions;
+    {
+        std::lock_guard lock(subscription_mutex_);
+        subscriptions.swap(pending_subscriptions_);
+    }
+    for (const auto& [command, pattern] : subscriptions)
+        redisAppendCommand(sub_ctx_, "%b %b", command.data(), command.size(), pattern.data(), pattern.size());
+
+    int done = 0;
+    while (!done)
+    {
+        if (redisBufferWrite(sub_ctx_, &done) != REDIS_OK)
+            return false;
+    }
+    return true;
+}
+
+std::string RedisHandler::escapePattern(const std::string& value)
+{
+    std::string escaped;
+    for (char c : value)
+    {
+        if (c == '*' || c == '?' || c == '[' || c == ']' || c == '\\')
+            escaped += '\\';
+        escaped += c;
+    }
+    return escaped;
+}
+
+std::string RedisHandler::keyspacePattern_(const std::string& topic_path)
+{
+    return "__keyspace@" + std::to_string(connection_options_().db) + "__:" + escapePattern(topic_path) + ":*";
+}
+
+void RedisHandler::requestSubscription_(const std::string& command, const std::string& pattern)
+{
+    std::unique_lock lock(subscription_mutex_);
+    pending_subscriptions_.emplace_back(command, pattern);
+    if (command == "PSUBSCRIBE" || command == "SUBSCRIBE")
+        subscriptions_[pattern] = command;
+    else
+        subscriptions_.erase(pattern);
+    std::uint64_t request = ++subscription_requests_;
+
+    std::uint64_t value = 1;
+    if (write(wake_fd_, &value, sizeof(value)) < 0)
+        throw std::runtime_error("Cannot wake subscriber worker up");
+    subscription_cv_.wait(lock, [&]()
+                          { return subscription_acks_ >= request || !worker_running_; });
+    if (subscription_acks_ < request)
+        throw std::runtime_error("Subscriber connection failed before " + command + " " + pattern + " was confirmed");
+}
+
+std::string RedisHandler::publishChannel(const std::string& topic_path)
+{
+    return "__cachemonitor__:" + topic_path;
+}
+
+void RedisHandler::subscribeTopic(const std::string& topic_path)
+{
+    if (config_.publish_values)
+        requestSubscription_("SUBSCRIBE", publishChannel(topic_path));
+    if (config_.invalidation_mode == InvalidationMode::Tracking)
+        trackPrefix_(topic_path + ":");
+    else if (config_.invalidation_mode == InvalidationMode::ChangeLog)
+        change_log_->subscribe(topic_path);
+    else
+    {
+        verifyKeyspaceEvents_();
+        requestSubscription_("PSUBSCRIBE", keyspacePattern_(topic_path));
     }
-}
\ No newline at end of file
+}
+
+void RedisHandler::unsubscribeTopic(const std::string& topic_path)
+{
+    if (config_.invalidation_mode == InvalidationMode::KeyspaceEvents)
+        requestSubscription_("PUNSUBSCRIBE", keyspacePattern_(topic_path));
+    else if (config_.invalidation_mode == InvalidationMode::ChangeLog)
+        change_log_->unsubscribe(topic_path);
+    if (config_.publish_values)
+        requestSubscription_("UNSUBSCRIBE", publishChannel(topic_path));
+}
+
+void RedisHandler::connectTracking_()
+{
+    sw::redis::ConnectionOptions options = connection_options_();
+    tracking_ctx_ = redisConnect(options.host.c_str(), options.port);
+    if (tracking_ctx_ == nullptr || tracking_ctx_->err)
+        throw std::runtime_error("Cannot connect tracking client to Redis: " + std::string(tracking_ctx_ ? tracking_ctx_->errstr : "allocation error"));
+
+    redisReply* id = static_cast<redisReply*>(redisCommand(sub_ctx_, "CLIENT ID"));
+    if (id == nullptr || id->type != REDIS_REPLY_INTEGER)
+    {
+        freeReplyObject(id);
+        throw std::runtime_error("Cannot get client ID of subscriber connection");
+    }
+    subscriber_id_ = id->integer;
+    freeReplyObject(id);
+
+    // Worker is not running yet, so the confirmation can be read synchronously.
+    redisReply* subscribed = static_cast<redisReply*>(redisCommand(sub_ctx_, "SUBSCRIBE __redis__:invalidate"));
+    if (subscribed == nullptr || subscribed->type != REDIS_REPLY_ARRAY)
+    {
+        freeReplyObject(subscribed);
+        throw std::runtime_error("Cannot subscribe to invalidations of tracked keys");
+    }
+    freeReplyObject(subscribed);
+}
+
+void RedisHandler::trackPrefix_(const std::string& prefix)
+{
+    std::lock_guard lock(tracking_mutex_);
+    if (tracking_prefixes_.count(prefix))
+        return;
+    enableTracking_(prefix);
+    tracking_prefixes_.insert(prefix);
+}
+
+void RedisHandler::enableTracking_(const std::string& prefix)
+{
+    // Prefixes are added to the tracking which is already enabled, tracking of other topics is never interrupted.
+    std::string redirect = std::to_string(subscriber_id_);
+    const char* argv[] = {"CLIENT", "TRACKING", "on", "REDIRECT", redirect.c_str(), "BCAST", "PREFIX", prefix.c_str()};
+    std::size_t argvlen[] = {6, 8, 2, 8, redirect.size(), 5, 6, prefix.size()};
+    redisReply* reply = static_cast<redisReply*>(redisCommandArgv(tracking_ctx_, 8, argv, argvlen));
+    if (reply == nullptr || reply->type == REDIS_REPLY_ERROR)
+    {
+        std::string error = reply ? std::string(reply->str, reply->len) : std::string(tracking_ctx_->errstr);
+        freeReplyObject(reply);
+        throw std::runtime_error("Cannot enable tracking of prefix " + prefix + ": " + error);
+    }
+    freeReplyObject(reply);
+}
+
+void RedisHandler::requireEventClass(char event_class)
+{
+    std::lock_guard lock(event_class_mutex_);
+    if (event_class_refs_[event_class]++ == 0)
+        updateKeyspaceEvents_();
+}
+
+void RedisHandler::releaseEventClass(char event_class)
+{
+    std::lock_guard lock(event_class_mutex_);
+    --event_class_refs_[event_class];
+}
+
+void RedisHandler::updateKeyspaceEvents_()
+{
+    if (config_.invalidation_mode != InvalidationMode::KeyspaceEvents)
+        return;
+
+    // Generic, expired and evicted events are needed by every value type to notice deleted keys.
+    std::string needed = "Kgxe";
+    for (const auto& [event_class, refs] : event_class_refs_)
+    {
+        if (refs > 0)
+            needed += event_class;
+    }
+    // Flags are shared with other processes and the operator, so missing classes are added and nothing is removed.
+    auto reply = redis_->command<std::vector<std::string>>("config", "get", "notify-keyspace-events");
+    std::string current = reply.size() == 2 ? reply[1] : std::string();
+    std::string flags = current;
+    for (char event_class : needed)
+    {
+        bool covered = current.find(event_class) != std::string::npos ||
+                       (current.find('A') != std::string::npos && std::string_view("g$lshztxed").find(event_class) != std::string_view::npos);
+        if (!covered)
+            flags += event_class;
+    }
+    if (flags != current)
+        redis_->command("config", "set", "notify-keyspace-events", flags);
+}
+
+void RedisHandler::verifyKeyspaceEvents_()
+{
+    std::lock_guard lock(event_class_mutex_);
+    updateKeyspaceEvents_();
+}
+
+bool RedisHandler::drainNotifications_()
+{
+    while (true)
+    {
+        void* reply = nullptr;
+        if (redisReaderGetReply(sub_ctx_->reader, &reply) != REDIS_OK)
+            return false;
+
+        if (reply != nullptr)
+        {
+            collectNotification_(reply);
+            if (batch_.size() >= config_.max_batch_size)
+            {
+                stat_backlog_bytes_.store(sub_ctx_->reader->len - sub_ctx_->reader->pos, std::memory_order_relaxed);
+                applyBatch_();
+            }
+            continue;
+        }
+
+        // Everything buffered is processed, read more only if it is available right now.
+        pollfd fd{sub_ctx_->fd, POLLIN, 0};
+        if (poll(&fd, 1, 0) <= 0)
+            break;
+        if (redisBufferRead(sub_ctx_) != REDIS_OK)
+            return false;
+    }
+    stat_backlog_bytes_.store(0, std::memory_order_relaxed);
+    applyBatch_();
+    return true;
+}
+
+void RedisHandler::collectNotification_(void* reply)
+{
+    redisReply* message = static_cast<redisReply*>(reply);
+    std::string_view type = message->type == REDIS_REPLY_ARRAY && message->elements > 0
+                                ? std::string_view(message->element[0]->str, message->element[0]->len)
+                                : std::string_view();
+    if (message->elements == 3 &&
+        (type == "psubscribe" || type == "punsubscribe" || type == "subscribe" || type == "unsubscribe"))
+    {
+        freeReplyObject(reply);
+        std::lock_guard lock(subscription_mutex_);
+        ++subscription_acks_;
+        subscription_cv_.notify_all();
+        return;
+    }
+    if (message->elements == 3 && type == "message")
+    {
+        if (std::string_view(message->element[1]->str, message->element[1]->len) == "__redis__:invalidate")
+            collectInvalidation_(reply);
+        else
+            collectPublished_(reply);
+        return;
+    }
+
+    KeyspaceChannel channel;
+    if (message->elements != 4 || type != "pmessage" ||
+        !KeyspaceChannel::parse(std::string_view(message->element[2]->str, message->element[2]->len), channel))
+    {
+        freeReplyObject(reply);
+        return;
+    }
+    channel.event = std::string_view(message->element[3]->str, message->element[3]->len);
+    batch_.push_back(channel);
+    batch_replies_.push_back(reply);
+}
+
+void RedisHandler::collectInvalidation_(void* reply)
+{
+    redisReply* keys = static_cast<redisReply*>(reply)->element[2];
+    if (keys->type != REDIS_REPLY_ARRAY)
+    {
+        // Flush of the database invalidates all keys at once.
+        freeReplyObject(reply);
+        applyBatch_();
+        TopicManager::getInstance().markAllChanged();
+        return;
+    }
+
+    KeyspaceChannel channel;
+    for (std::size_t i = 0; i < keys->elements; ++i)
+    {
+        if (KeyspaceChannel::parseKey(std::string_view(keys->element[i]->str, keys->element[i]->len), channel))
+            batch_.push_back(channel);
+    }
+    batch_replies_.push_back(reply);
+}
+
+void RedisHandler::collectPublished_(void* reply)
+{
+    redisReply* message = static_cast<redisReply*>(reply);
+    KeyspaceChannel channel;
+    std::string_view payload(message->element[2]->str, message->element[2]->len);
+    std::size_t id_end = payload.find(':');
+    if (!KeyspaceChannel::parse(std::string_view(message->element[1]->str, message->element[1]->len), channel) ||
+        id_end == std::string_view::npos)
+    {
+        freeReplyObject(reply);
+        return;
+    }
+    channel.id = payload.substr(0, id_end);
+    channel.published = true;
+    channel.value = payload.substr(id_end + 1);
+    batch_.push_back(channel);
+    batch_replies_.push_back(reply);
+}
+
+void RedisHandler::applyBatch_()
+{
+    if (batch_.empty())
+        return;
+
+    std::stable_sort(batch_.begin(), batch_.end(), [](const KeyspaceChannel& lhs, const KeyspaceChannel& rhs)
+                     { return lhs.topic_path < rhs.topic_path; });
+
+    auto group_begin = batch_.begin();
+    while (group_begin != batch_.end())
+    {
+        auto group_end = std::find_if(group_begin, batch_.end(), [&](const KeyspaceChannel& channel)
+                                      { return channel.topic_path != group_begin->topic_path; });
+        batch_group_.assign(group_begin, group_end);
+        TopicManager::getInstance().addChangedParameters(group_begin->topic_path, batch_group_);
+        group_begin = group_end;
+    }
+
+    std::uint64_t batch_size = batch_.size();
+    stat_messages_.fetch_add(batch_size, std::memory_order_relaxed);
+    stat_batches_.fetch_add(1, std::memory_order_relaxed);
+    stat_last_batch_size_.store(batch_size, std::memory_order_relaxed);
+    if (batch_size > stat_max_batch_size_.load(std::memory_order_relaxed))
+        stat_max_batch_size_.store(batch_size, std::memory_order_relaxed);
+    batch_.clear();
+    for (void* reply : batch_replies_)
+        freeReplyObject(reply);
+    batch_replies_.clear();
+}
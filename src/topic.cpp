@@ -1,42 +1,229 @@
 #include <topic.h>
 #include <redis_handler.h>
 #include <cache_value.h>
+#include <change_log.h>
 #include <iostream>
+#include <iterator>
 
-Topic::Topic(std::string topic_path){
+Topic::Topic(std::string topic_path) : epoch_(0){
     topic_path_ = topic_path;
 }
 
+Topic::~Topic(){
+    std::unique_lock lock(cache_values_mutex_);
+    for (auto& [id, cache_value] : cache_values_) {
+        if (cache_value != nullptr) {
+            cache_value->topic_ = nullptr;
+            RedisHandler::getInstance().releaseEventClass(cache_value->keyspace_event_class_);
+        }
+    }
+}
+
 std::string Topic::getTopicPath(){
     return topic_path_;
 }
 
 std::set<std::string> Topic::check_changed_parameters(){
-    return changed_parameters_;
+    std::shared_lock lock(cache_values_mutex_);
+    std::set<std::string> changed_parameters;
+    for (const auto& [id, cache_value] : cache_values_) {
+        if (cache_value != nullptr && cache_value->isChanged())
+            changed_parameters.insert(id);
+    }
+    return changed_parameters;
 }
 
 void Topic::removeChangedParameter(std::string id){
-    changed_parameters_.erase(id);
+    std::shared_lock lock(cache_values_mutex_);
+    auto it = cache_values_.find(id);
+    if (it != cache_values_.end() && it->second != nullptr)
+        it->second->markFetched();
 }
 
 void Topic::clear_changed_parameters(){
-    changed_parameters_.clear();
+    std::shared_lock lock(cache_values_mutex_);
+    for (auto& [id, cache_value] : cache_values_) {
+        if (cache_value != nullptr)
+            cache_value->markFetched();
+    }
+}
+
+void Topic::refresh(){
+    std::vector<ChangedValue> changed_values;
+    collectChanged_(changed_values);
+    refreshValues_(changed_values);
+}
+
+void Topic::collectChanged_(std::vector<ChangedValue>& changed_values){
+    // Epoch is shared by all values of the topic, so it is loaded once.
+    std::uint64_t epoch = getEpoch();
+    std::shared_lock lock(cache_values_mutex_);
+    for (const auto& [id, cache_value] : cache_values_) {
+        if (cache_value == nullptr)
+            continue;
+        // Version is loaded before fetching, so a change arriving during the fetch is not lost.
+        std::uint64_t version = cache_value->version_.load(std::memory_order_acquire);
+        if (version != cache_value->fetched_version_ || epoch != cache_value->fetched_epoch_)
+            changed_values.push_back({cache_value, version, epoch});
+    }
+}
+
+void Topic::loadValues_(const std::vector<AbstractCacheValue*>& cache_values){
+    std::vector<ChangedValue> loaded_values;
+    for (AbstractCacheValue* cache_value : cache_values) {
+        std::uint64_t epoch = cache_value->epoch_();
+        loaded_values.push_back({cache_value, cache_value->version_.load(std::memory_order_acquire), epoch});
+    }
+    refreshValues_(loaded_values);
+}
+
+void Topic::refreshValues_(const std::vector<ChangedValue>& changed_values){
+    if (changed_values.empty())
+        return;
+
+    std::vector<ScalarCacheValue*> scalars;
+    std::vector<std::string> scalar_keys;
+    std::vector<ContainerCacheValue*> containers;
+    for (const auto& [cache_value, version, epoch] : changed_values) {
+        // Deleted and published values are applied locally, everything else is fetched whole.
+        std::string published_value;
+        KeyEvent event = cache_value->takeEvent_(published_value);
+        if (epoch != cache_value->fetched_epoch_)
+            event = KeyEvent::Changed;
+        if (event == KeyEvent::Deleted) {
+            cache_value->clearValue_();
+            continue;
+        }
+        if (event == KeyEvent::Published) {
+            cache_value->applyPublished_(published_value);
+            continue;
+        }
+        if (auto scalar = dynamic_cast<ScalarCacheValue*>(cache_value)) {
+            scalars.push_back(scalar);
+            scalar_keys.push_back(cache_value->topic_->getTopicPath() + ":" + cache_value->getId());
+        }
+        else if (auto container = dynamic_cast<ContainerCacheValue*>(cache_value)) {
+            containers.push_back(container);
+        }
+    }
+
+    if (!scalars.empty() || !containers.empty()) {
+        // Pipeline holds a connection of the pool until it is destroyed.
+        auto pipeline = RedisHandler::getInstance().getRedis()->pipeline(false);
+        if (!scalars.empty())
+            pipeline.mget(scalar_keys.begin(), scalar_keys.end());
+        for (ContainerCacheValue* container : containers)
+            container->queueFetch_(pipeline);
+        auto replies = pipeline.exec();
+
+        std::size_t index = 0;
+        if (!scalars.empty()) {
+            std::vector<sw::redis::OptionalString> values;
+            replies.get(index++, std::back_inserter(values));
+            for (std::size_t i = 0; i < scalars.size(); ++i) {
+                // Deletion may not have been notified, e.g. after the epoch changed, so a missing key clears the value.
+                if (values[i])
+                    scalars[i]->applyEncoded_(*values[i]);
+                else
+                    scalars[i]->clearValue_();
+            }
+        }
+        for (ContainerCacheValue* container : containers)
+            container->applyFetch_(replies, index++);
+    }
+
+    for (const auto& [cache_value, version, epoch] : changed_values) {
+        cache_value->fetched_version_ = version;
+        cache_value->fetched_epoch_ = epoch;
+    }
+}
+
+void Topic::markChanged(std::string id){
+    std::shared_lock lock(cache_values_mutex_);
+    auto it = cache_values_.find(id);
+    if (it != cache_values_.end() && it->second != nullptr)
+        it->second->markChanged();
+}
+
+void Topic::markChanged(const std::vector<KeyspaceChannel>& changes){
+    std::shared_lock lock(cache_values_mutex_);
+    for (const auto& change : changes) {
+        auto it = cache_values_.find(change.id);
+        if (it == cache_values_.end() || it->second == nullptr)
+            continue;
+        if (change.published)
+            it->second->markPublished(change.value);
+        else
+            it->second->markChanged(change.event);
+    }
+}
+
+void Topic::markAllChanged(){
+    epoch_.fetch_add(1, std::memory_order_release);
+}
+
+std::uint64_t Topic::getEpoch() const{
+    return TopicManager::getInstance().getEpoch() + epoch_.load(std::memory_order_acquire);
 }
 
 void Topic::addCacheValue(AbstractCacheValue* cache_value){
-    cache_values_[cache_value->getId()] = cache_value;
+    cache_value->keyspace_event_class_ = cache_value->keyspaceEventClass_();
+    RedisHandler::getInstance().requireEventClass(cache_value->keyspace_event_class_);
+
+    AbstractCacheValue* replaced_value = nullptr;
+    {
+        std::unique_lock lock(cache_values_mutex_);
+        AbstractCacheValue*& registered_value = cache_values_[cache_value->getId()];
+        replaced_value = registered_value;
+        registered_value = cache_value;
+    }
+    if (replaced_value != nullptr && replaced_value != cache_value)
+        RedisHandler::getInstance().releaseEventClass(replaced_value->keyspace_event_class_);
+}
+
+void Topic::detachCacheValue_(AbstractCacheValue* cache_value){
+    {
+        std::unique_lock lock(cache_values_mutex_);
+        auto it = cache_values_.find(cache_value->getId());
+        if (it == cache_values_.end() || it->second != cache_value)
+            return;
+        cache_values_.erase(it);
+    }
+    RedisHandler::getInstance().releaseEventClass(cache_value->keyspace_event_class_);
 }
 
 void Topic::removeCacheValue(std::string id){
-    delete cache_values_[id];
-    cache_values_.erase(id);
-    RedisHandler::getInstance().getRedis()->del(topic_path_ + ":" + id);
+    AbstractCacheValue* cache_value = nullptr;
+    {
+        std::unique_lock lock(cache_values_mutex_);
+        auto it = cache_values_.find(id);
+        if (it != cache_values_.end()) {
+            cache_value = it->second;
+            cache_values_.erase(it);
+        }
+    }
+    if (cache_value != nullptr)
+        RedisHandler::getInstance().releaseEventClass(cache_value->keyspace_event_class_);
+    // Key is deleted anyway, so pending write is dropped instead of being flushed by the destructor.
+    if (auto scalar = dynamic_cast<ScalarCacheValue*>(cache_value))
+        scalar->discardPendingWrite_();
+    delete cache_value;
+    auto pipeline = RedisHandler::getInstance().getRedis()->pipeline(false);
+    pipeline.del(topic_path_ + ":" + id);
+    if (ChangeLog* change_log = RedisHandler::getInstance().getChangeLog())
+        change_log->queueAppend(pipeline, topic_path_, id);
+    pipeline.exec();
 }
 
 AbstractCacheValue* Topic::getCacheValue(std::string id){
-    return cache_values_[id];
+    std::shared_lock lock(cache_values_mutex_);
+    auto it = cache_values_.find(id);
+    if (it != cache_values_.end())
+        return it->second;
+    return nullptr;
 }
 
 bool Topic::exists(std::string id){
+    std::shared_lock lock(cache_values_mutex_);
     return cache_values_.find(id) != cache_values_.end();
 }
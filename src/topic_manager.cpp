@@ -1,7 +1,12 @@
 #include <topic_manager.h>
 #include <topic.h>
 #include <redis_handler.h>
+#include <cache_value.h>
+#include <change_log.h>
+#include <keyspace_channel.h>
 #include <iostream>
+#include <iterator>
+#include <set>
 
 TopicManager& TopicManager::getInstance()
 {
@@ -10,32 +15,145 @@ TopicManager& TopicManager::getInstance()
 }
 
 Topic* TopicManager::getTopic(std::string topic_path){
-    if(topics_.find(topic_path) != topics_.end())
-        return topics_[topic_path];
+    std::shared_lock lock(topics_mutex_);
+    auto it = topics_.find(topic_path);
+    if (it != topics_.end())
+        return it->second;
     return nullptr;
 }
 
 void TopicManager::createTopic(std::string topic_path){
-    topics_[topic_path] = new Topic(topic_path);
+    {
+        std::unique_lock lock(topics_mutex_);
+        if (topics_.find(topic_path) != topics_.end())
+            return;
+        topics_[topic_path] = new Topic(topic_path);
+    }
+    RedisHandler::getInstance().subscribeTopic(topic_path);
+}
+
+std::vector<std::unique_ptr<AbstractCacheValue>> TopicManager::hydrateTopic(std::string topic_path){
+    // Topic is subscribed before keys are scanned, so changes made during hydration are not missed.
+    createTopic(topic_path);
+    Topic* topic = getTopic(topic_path);
+    sw::redis::Redis* redis = RedisHandler::getInstance().getRedis();
+
+    std::set<std::string> ids;
+    std::vector<std::pair<std::string, std::string>> keys;
+    std::string pattern = RedisHandler::escapePattern(topic_path) + ":*";
+    long long cursor = 0;
+    do {
+        std::vector<std::string> page;
+        cursor = redis->scan(cursor, pattern, 1000, std::back_inserter(page));
+        if (page.empty())
+            continue;
+
+        auto pipeline = redis->pipeline(false);
+        for (const auto& key : page)
+            pipeline.type(key);
+        auto replies = pipeline.exec();
+        for (std::size_t i = 0; i < page.size(); ++i) {
+            std::string id = page[i].substr(topic_path.size() + 1);
+            // SCAN may return a key more than once.
+            if (id.find(':') != std::string::npos || topic->exists(id) || !ids.insert(id).second)
+                continue;
+            keys.emplace_back(id, replies.get<std::string>(i));
+        }
+    } while (cursor != 0);
+
+    // Encoding of a string does not tell its type, e.g. "1" may be a float, so strings are attached as they are.
+    std::vector<std::unique_ptr<AbstractCacheValue>> values;
+    for (const auto& [id, type] : keys) {
+        if (type == "string")
+            values.push_back(std::make_unique<CacheString>(id, topic_path, AttachTag()));
+        else if (type == "list")
+            values.push_back(std::make_unique<CacheList>(id, topic_path, AttachTag()));
+        else if (type == "hash")
+            values.push_back(std::make_unique<CacheMap>(id, topic_path, AttachTag()));
+        else if (type == "set")
+            values.push_back(std::make_unique<CacheSet>(id, topic_path, AttachTag()));
+    }
+
+    // Values are registered now, so they are loaded after any change made while they were classified.
+    std::vector<AbstractCacheValue*> loaded_values;
+    for (const auto& value : values)
+        loaded_values.push_back(value.get());
+    Topic::loadValues_(loaded_values);
+    return values;
 }
 
 void TopicManager::removeTopic(std::string topic_path){
-    delete topics_[topic_path];
-    topics_.erase(topic_path);
-    RedisHandler::getInstance().getRedis()->del(topic_path);
+    Topic* topic = nullptr;
+    {
+        std::unique_lock lock(topics_mutex_);
+        auto it = topics_.find(topic_path);
+        if (it != topics_.end()) {
+            topic = it->second;
+            topics_.erase(it);
+        }
+    }
+    if (topic != nullptr)
+        RedisHandler::getInstance().unsubscribeTopic(topic_path);
+    delete topic;
+    auto pipeline = RedisHandler::getInstance().getRedis()->pipeline(false);
+    pipeline.del(topic_path);
+    // Key of a nested topic path is a value of its parent topic, so its deletion is logged for the parent.
+    KeyspaceChannel key;
+    ChangeLog* change_log = RedisHandler::getInstance().getChangeLog();
+    if (change_log != nullptr && KeyspaceChannel::parseKey(topic_path, key) && !key.id.empty())
+        change_log->queueAppend(pipeline, std::string(key.topic_path), std::string(key.id));
+    pipeline.exec();
 }
 
 void TopicManager::changeTopic(std::string id, std::string old_topic_path, std::string new_topic_path){
-    topics_[new_topic_path]->addCacheValue(topics_[old_topic_path]->cache_values_[id]);
-    topics_[old_topic_path]->cache_values_.erase(id);
+    Topic* old_topic = getTopic(old_topic_path);
+    AbstractCacheValue* cache_value = old_topic->getCacheValue(id);
+    getTopic(new_topic_path)->addCacheValue(cache_value);
+    old_topic->detachCacheValue_(cache_value);
 }
 
 bool TopicManager::exists(std::string topic_path){
+    std::shared_lock lock(topics_mutex_);
     return topics_.find(topic_path) != topics_.end();
 }
 
 void TopicManager::addChangedParameter(std::string topic_path, std::string parameter){
-    if (!exists(topic_path))
+    std::shared_lock lock(topics_mutex_);
+    auto it = topics_.find(topic_path);
+    if (it == topics_.end())
         return;
-    topics_[topic_path]->changed_parameters_.insert(parameter);
+    it->second->markChanged(parameter);
+}
+
+void TopicManager::refresh(){
+    std::vector<Topic::ChangedValue> changed_values;
+    {
+        std::shared_lock lock(topics_mutex_);
+        for (const auto& [topic_path, topic] : topics_)
+            topic->collectChanged_(changed_values);
+    }
+    Topic::refreshValues_(changed_values);
+}
+
+void TopicManager::addChangedParameters(std::string_view topic_path, const std::vector<KeyspaceChannel>& changes){
+    std::shared_lock lock(topics_mutex_);
+    auto it = topics_.find(topic_path);
+    if (it == topics_.end())
+        return;
+    it->second->markChanged(changes);
+}
+
+std::uint64_t TopicManager::getEpoch() const{
+    return epoch_.load(std::memory_order_acquire);
+}
+
+void TopicManager::markAllChanged(){
+    epoch_.fetch_add(1, std::memory_order_release);
+}
+
+void TopicManager::markAllChanged(std::string_view topic_path){
+    std::shared_lock lock(topics_mutex_);
+    auto it = topics_.find(topic_path);
+    if (it != topics_.end())
+        it->second->markAllChanged();
 }
\ No newline at end of file
@@ -0,0 +1,95 @@
+#include <redis_handler.h>
+#include <topic_manager.h>
+#include <cache_value.h>
+#include <topic.h>
+#include <thread>
+#include <chrono>
+#include <memory>
+#include <set>
+#include <gtest/gtest.h>
+
+/**
+ * @brief Tests of `InvalidationMode::Tracking`, which has to be configured before the first use of the library.
+ */
+class TestTrackingInvalidation : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        RedisHandler::getInstance().getRedis()->command("FLUSHALL");
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+};
+
+TEST_F(TestTrackingInvalidation, CheckPrefixInvalidation)
+{
+    TopicManager::getInstance().createTopic("tracked_topic");
+    TopicManager::getInstance().createTopic("other_tracked_topic");
+    auto cache_value = std::make_shared<CacheString>("test_id", "tracked_topic", "test_value");
+    auto other_value = std::make_shared<CacheString>("test_id", "other_tracked_topic", "other_value");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    // Own writes are invalidated as well, so values are read once to be up to date.
+    ASSERT_EQ("test_value", cache_value->toString()) << "String is not correct";
+    ASSERT_EQ("other_value", other_value->toString()) << "Other string is not correct";
+    ASSERT_FALSE(cache_value->isChanged()) << "String is marked as changed after read";
+
+    RedisHandler::getInstance().getRedis()->set("tracked_topic:test_id", "new_value");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_TRUE(cache_value->isChanged()) << "Invalidation of tracked key did not reach the value";
+    ASSERT_EQ(std::set<std::string>{"test_id"}, TopicManager::getInstance().getTopic("tracked_topic")->check_changed_parameters()) << "Changed parameters of topic are not correct";
+    ASSERT_FALSE(other_value->isChanged()) << "Value of other topic is marked as changed";
+    ASSERT_EQ("new_value", cache_value->toString()) << "String after invalidation is not correct";
+
+    // Keys outside of registered prefixes are not tracked.
+    RedisHandler::getInstance().getRedis()->set("untracked_topic:test_id", "value");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_FALSE(cache_value->isChanged()) << "Untracked key invalidated a value";
+}
+
+TEST_F(TestTrackingInvalidation, CheckFlushInvalidation)
+{
+    TopicManager::getInstance().createTopic("flushed_topic");
+    auto cache_value = std::make_shared<CacheString>("test_id", "flushed_topic", "test_value");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_EQ("test_value", cache_value->toString()) << "String is not correct";
+    std::uint64_t epoch = TopicManager::getInstance().getEpoch();
+
+    // Flush is invalidated with a null key list, which invalidates every value.
+    RedisHandler::getInstance().getRedis()->command("FLUSHDB");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_LT(epoch, TopicManager::getInstance().getEpoch()) << "Flush did not bump the global epoch";
+    ASSERT_TRUE(cache_value->isChanged()) << "String is not marked as changed after flush";
+    ASSERT_EQ("", cache_value->toString()) << "String after flush is not cleared";
+}
+
+TEST_F(TestTrackingInvalidation, CheckReconnectRedirect)
+{
+    TopicManager::getInstance().createTopic("reconnect_topic");
+    auto redis = RedisHandler::getInstance().getRedis();
+    auto cache_value = std::make_shared<CacheString>("test_id", "reconnect_topic", "test_value");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_EQ("test_value", cache_value->toString()) << "String is not correct";
+    NotificationStats before = RedisHandler::getInstance().getNotificationStats();
+
+    redis->command<long long>("CLIENT", "KILL", "TYPE", "pubsub");
+    for (int i = 0; i < 50 && RedisHandler::getInstance().getNotificationStats().reconnects == before.reconnects; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_LT(before.reconnects, RedisHandler::getInstance().getNotificationStats().reconnects) << "Subscriber was not reconnected";
+    ASSERT_TRUE(cache_value->isChanged()) << "String is not stale after reconnect";
+    ASSERT_EQ("test_value", cache_value->toString()) << "String after reconnect is not correct";
+
+    // Invalidations are redirected to the new subscriber connection.
+    redis->set("reconnect_topic:test_id", "new_value");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    ASSERT_TRUE(cache_value->isChanged()) << "Invalidation is not redirected to the reconnected subscriber";
+    ASSERT_EQ("new_value", cache_value->toString()) << "String after redirected invalidation is not correct";
+}
+
+int main()
+{
+    RedisConfig config;
+    config.invalidation_mode = InvalidationMode::Tracking;
+    RedisHandler::configure(config);
+    ::testing::InitGoogleTest();
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,33 @@
+#include <value_codec.h>
+#include <charconv>
+
+std::string DefaultCodec<int>::encode(int value){
+    char buffer[16];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    return std::string(buffer, result.ptr);
+}
+
+int DefaultCodec<int>::decode(const std::string& encoded){
+    int value = 0;
+    const char* end = encoded.data() + encoded.size();
+    auto result = std::from_chars(encoded.data(), end, value);
+    if (result.ec != std::errc() || result.ptr != end)
+        throw std::invalid_argument("Cannot decode integer from \"" + encoded + "\"");
+    return value;
+}
+
+std::string DefaultCodec<float>::encode(float value){
+    // Shortest round-trip form of a float never exceeds 16 characters, e.g. -1.17549435e-38.
+    char buffer[32];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    return std::string(buffer, result.ptr);
+}
+
+float DefaultCodec<float>::decode(const std::string& encoded){
+    float value = 0.0f;
+    const char* end = encoded.data() + encoded.size();
+    auto result = std::from_chars(encoded.data(), end, value);
+    if (result.ec != std::errc() || result.ptr != end)
+        throw std::invalid_argument("Cannot decode float from \"" + encoded + "\"");
+    return value;
+}
@@ -0,0 +1,106 @@
+#include <write_batch.h>
+#include <cache_value.h>
+#include <topic.h>
+
+WriteBatch::WriteBatch(bool atomic) : atomic_(atomic){}
+
+void WriteBatch::add_(AbstractCacheValue& value, std::vector<std::string> command, std::uint32_t echoes, std::function<void()> apply){
+    command.insert(command.begin() + 1, value.getTopic()->getTopicPath() + ":" + value.getId());
+    operations_.push_back(Operation{&value, std::move(command), echoes, std::move(apply)});
+}
+
+void WriteBatch::addScalar_(ScalarCacheValue& value, const std::string& encoded, std::function<void()> apply){
+    operations_.push_back(Operation{&value, value.writeCommand_(encoded), ScalarCacheValue::writeEchoes_(), std::move(apply)});
+}
+
+void WriteBatch::rpush(CacheList& value, std::string element){
+    add_(value, {"RPUSH", element}, 1, [&value, element](){
+        value.value_.push_back(element);
+    });
+}
+
+void WriteBatch::lpush(CacheList& value, std::string element){
+    add_(value, {"LPUSH", element}, 1, [&value, element](){
+        value.value_.push_front(element);
+    });
+}
+
+void WriteBatch::addKey(CacheMap& value, std::string key, std::string val){
+    add_(value, {"HSET", key, val}, 1, [&value, key, val](){
+        value.value_[key] = val;
+    });
+}
+
+void WriteBatch::eraseKey(CacheMap& value, std::string key){
+    add_(value, {"HDEL", key}, 0, [&value, key](){
+        value.value_.erase(key);
+    });
+}
+
+void WriteBatch::addValue(CacheSet& value, std::string val){
+    add_(value, {"SADD", val}, 0, [&value, val](){
+        value.value_.insert(val);
+    });
+}
+
+void WriteBatch::removeValue(CacheSet& value, std::string val){
+    add_(value, {"SREM", val}, 0, [&value, val](){
+        value.value_.erase(val);
+    });
+}
+
+bool WriteBatch::empty() const{
+    return operations_.empty();
+}
+
+void WriteBatch::commit(){
+    if (operations_.empty())
+        return;
+    // Queued scalar writes would overwrite the batch if they were flushed after it.
+    RedisHandler::getInstance().flush();
+
+    sw::redis::Redis* redis = RedisHandler::getInstance().getRedis();
+    if (atomic_) {
+        auto transaction = redis->transaction(true, false);
+        commit_(transaction);
+    }
+    else {
+        auto pipeline = redis->pipeline(false);
+        commit_(pipeline);
+    }
+}
+
+template <typename Queued>
+void WriteBatch::commit_(Queued& queued){
+    std::vector<Operation> operations;
+    operations.swap(operations_);
+    for (const auto& operation : operations) {
+        for (std::uint32_t i = 0; i < operation.echoes; ++i)
+            operation.value->expectEcho_();
+        queued.command(operation.command.begin(), operation.command.end());
+    }
+    // Change log entries are queued after all writes, so replies of the writes keep the indexes of their operations.
+    for (const auto& operation : operations)
+        operation.value->logChange_(queued);
+
+    try {
+        auto replies = queued.exec();
+        for (std::size_t i = 0; i < operations.size(); ++i) {
+            if (sw::redis::reply::is_error(replies.get(i))) {
+                for (std::uint32_t echo = 0; echo < operations[i].echoes; ++echo)
+                    operations[i].value->cancelEcho_();
+                operations[i].value->version_.fetch_add(1, std::memory_order_release);
+            }
+            else {
+                operations[i].apply();
+            }
+        }
+    }
+    catch (...) {
+        for (const auto& operation : operations) {
+            for (std::uint32_t i = 0; i < operation.echoes; ++i)
+                operation.value->cancelEcho_();
+        }
+        throw;
+    }
+}
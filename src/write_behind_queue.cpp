@@ -0,0 +1,136 @@
+#include <write_behind_queue.h>
+#include <cache_value.h>
+#include <change_log.h>
+#include <topic.h>
+#include <iostream>
+
+WriteBehindQueue::WriteBehindQueue(sw::redis::Redis* redis, ChangeLog* change_log, std::chrono::milliseconds interval, std::size_t max_batch_size)
+    : redis_(redis), change_log_(change_log), interval_(interval), max_batch_size_(max_batch_size), stop_(false)
+{
+    thread_ = std::thread(&WriteBehindQueue::worker_, this);
+}
+
+WriteBehindQueue::~WriteBehindQueue()
+{
+    {
+        std::lock_guard lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+    try
+    {
+        flushPending_();
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Write-behind flush failed: " << e.what() << std::endl;
+    }
+}
+
+void WriteBehindQueue::enqueue(ScalarCacheValue* value, std::vector<std::string> command)
+{
+    bool full = false;
+    {
+        std::lock_guard lock(mutex_);
+        auto [it, inserted] = pending_.try_emplace(value, std::move(command));
+        if (inserted)
+        {
+            // Only one write is sent for all coalesced writes, so only its echoes are expected.
+            for (std::uint32_t i = 0; i < ScalarCacheValue::writeEchoes_(); ++i)
+                value->expectEcho_();
+            value->write_pending_.store(true, std::memory_order_release);
+        }
+        else
+        {
+            it->second = std::move(command);
+        }
+        full = pending_.size() >= max_batch_size_;
+    }
+    if (full)
+        cv_.notify_one();
+}
+
+void WriteBehindQueue::discard(ScalarCacheValue* value)
+{
+    std::lock_guard flush_lock(flush_mutex_);
+    std::lock_guard lock(mutex_);
+    if (pending_.erase(value) == 0)
+        return;
+    for (std::uint32_t i = 0; i < ScalarCacheValue::writeEchoes_(); ++i)
+        value->cancelEcho_();
+    value->write_pending_.store(false, std::memory_order_release);
+}
+
+void WriteBehindQueue::flush()
+{
+    flushPending_();
+}
+
+void WriteBehindQueue::worker_()
+{
+    std::unique_lock lock(mutex_);
+    while (!stop_)
+    {
+        cv_.wait_for(lock, interval_, [&]()
+                     { return stop_ || pending_.size() >= max_batch_size_; });
+        lock.unlock();
+        try
+        {
+            flushPending_();
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Write-behind flush failed: " << e.what() << std::endl;
+        }
+        lock.lock();
+    }
+}
+
+void WriteBehindQueue::flushPending_()
+{
+    std::lock_guard flush_lock(flush_mutex_);
+    std::unordered_map<ScalarCacheValue*, std::vector<std::string>> writes;
+    {
+        std::lock_guard lock(mutex_);
+        writes.swap(pending_);
+    }
+    if (writes.empty())
+        return;
+
+    std::exception_ptr error;
+    try
+    {
+        auto pipeline = redis_->pipeline(false);
+        for (const auto& [value, command] : writes)
+            pipeline.command(command.begin(), command.end());
+        if (change_log_ != nullptr)
+        {
+            for (const auto& [value, command] : writes)
+                change_log_->queueAppend(pipeline, value->getTopic()->getTopicPath(), value->getId());
+        }
+        pipeline.exec();
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+    }
+
+    {
+        std::lock_guard lock(mutex_);
+        for (const auto& [value, command] : writes)
+        {
+            if (error)
+            {
+                for (std::uint32_t i = 0; i < ScalarCacheValue::writeEchoes_(); ++i)
+                    value->cancelEcho_();
+                value->version_.fetch_add(1, std::memory_order_release);
+            }
+            // Value written again during the flush still has a pending write.
+            if (pending_.find(value) == pending_.end())
+                value->write_pending_.store(false, std::memory_order_release);
+        }
+    }
+    if (error)
+        std::rethrow_exception(error);
+}